@@ -0,0 +1,104 @@
+#include "AllocationTracker.h"
+
+#include <cstdlib>
+#include <new>
+
+thread_local AllocationSite AllocationTracker::site_{AllocationSite::None};
+thread_local std::array<AllocationStats, static_cast<std::size_t>(AllocationSite::Count)> AllocationTracker::stats_{};
+thread_local std::size_t AllocationTracker::violationCount_{};
+thread_local bool AllocationTracker::isStrict_{false};
+
+void AllocationTracker::Reset()
+{
+    stats_ = {};
+    violationCount_ = 0;
+}
+
+const AllocationStats &AllocationTracker::GetStats(AllocationSite site)
+{
+    return stats_[static_cast<std::size_t>(site)];
+}
+
+const char *AllocationTracker::GetName(AllocationSite site)
+{
+    switch (site)
+    {
+    case AllocationSite::None:
+        return "None";
+    case AllocationSite::AddOrder:
+        return "AddOrder";
+    case AllocationSite::CancelOrder:
+        return "CancelOrder";
+    case AllocationSite::ModifyOrder:
+        return "ModifyOrder";
+    case AllocationSite::MassQuote:
+        return "MassQuote";
+    case AllocationSite::MassCancel:
+        return "MassCancel";
+    case AllocationSite::MatchTrades:
+        return "MatchTrades";
+    default:
+        return "Unknown";
+    }
+}
+
+void AllocationTracker::SetStrict(bool isStrict)
+{
+    isStrict_ = isStrict;
+}
+
+std::size_t AllocationTracker::GetViolationCount()
+{
+    return violationCount_;
+}
+
+void AllocationTracker::RecordAllocation(std::size_t bytes)
+{
+    if (site_ == AllocationSite::None)
+        return;
+
+    auto &stats = stats_[static_cast<std::size_t>(site_)];
+    stats.allocations_++;
+    stats.bytes_ += bytes;
+
+    if (isStrict_ && site_ != AllocationSite::MatchTrades)
+        violationCount_++;
+}
+
+#ifdef ORDERBOOK_TRACK_ALLOCATIONS
+
+// replacements for the global allocation functions, every other form of new and delete in the standard library forwards to these
+
+namespace
+{
+    void *Allocate(std::size_t size, std::size_t alignment)
+    {
+        AllocationTracker::RecordAllocation(size);
+
+        if (size == 0)
+            size = 1;
+
+        void *memory = alignment <= alignof(std::max_align_t)
+                           ? std::malloc(size)
+                           : std::aligned_alloc(alignment, (size + alignment - 1) / alignment * alignment);
+        if (memory == nullptr)
+            throw std::bad_alloc{};
+        return memory;
+    }
+}
+
+void *operator new(std::size_t size) { return Allocate(size, alignof(std::max_align_t)); }
+void *operator new[](std::size_t size) { return Allocate(size, alignof(std::max_align_t)); }
+void *operator new(std::size_t size, std::align_val_t alignment) { return Allocate(size, static_cast<std::size_t>(alignment)); }
+void *operator new[](std::size_t size, std::align_val_t alignment) { return Allocate(size, static_cast<std::size_t>(alignment)); }
+
+void operator delete(void *memory) noexcept { std::free(memory); }
+void operator delete[](void *memory) noexcept { std::free(memory); }
+void operator delete(void *memory, std::size_t) noexcept { std::free(memory); }
+void operator delete[](void *memory, std::size_t) noexcept { std::free(memory); }
+void operator delete(void *memory, std::align_val_t) noexcept { std::free(memory); }
+void operator delete[](void *memory, std::align_val_t) noexcept { std::free(memory); }
+void operator delete(void *memory, std::size_t, std::align_val_t) noexcept { std::free(memory); }
+void operator delete[](void *memory, std::size_t, std::align_val_t) noexcept { std::free(memory); }
+
+#endif
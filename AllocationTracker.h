@@ -0,0 +1,81 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+
+// attributes heap allocations to the order book operation that made them. tracking is only compiled in when building with
+// ORDERBOOK_TRACK_ALLOCATIONS, which also replaces the global operator new and delete in AllocationTracker.cpp.
+// without it AllocationScope is empty and costs nothing
+
+enum class AllocationSite : std::uint8_t
+{
+    None,
+    AddOrder,
+    CancelOrder,
+    ModifyOrder,
+    MassQuote,
+    // includes the vector of cancelled ids it returns
+    MassCancel,
+    // the Trades buffer returned to the caller, the one allocation a matching operation is allowed to make
+    MatchTrades,
+    Count,
+};
+
+struct AllocationStats
+{
+    std::size_t calls_;
+    std::size_t allocations_;
+    std::size_t bytes_;
+};
+
+// counters are per thread, read them from the thread that drove the book
+class AllocationTracker
+{
+public:
+    static void Reset();
+    static const AllocationStats &GetStats(AllocationSite site);
+    static const char *GetName(AllocationSite site);
+
+    // in strict mode any allocation inside AddOrder, CancelOrder, ModifyOrder, MassQuote or MassCancel, other than the returned trades, is a violation
+    static void SetStrict(bool isStrict);
+    static std::size_t GetViolationCount();
+
+    static void RecordAllocation(std::size_t bytes);
+
+private:
+    friend class AllocationScope;
+
+    static thread_local AllocationSite site_;
+    static thread_local std::array<AllocationStats, static_cast<std::size_t>(AllocationSite::Count)> stats_;
+    static thread_local std::size_t violationCount_;
+    static thread_local bool isStrict_;
+};
+
+// marks the enclosing block as belonging to an operation. the outermost operation keeps the attribution, so the cancel and add
+// that ModifyOrder makes are counted as part of the modify, only MatchTrades overrides it
+class AllocationScope
+{
+public:
+#ifdef ORDERBOOK_TRACK_ALLOCATIONS
+    explicit AllocationScope(AllocationSite site) : previous_{AllocationTracker::site_}
+    {
+        if (previous_ == AllocationSite::None || site == AllocationSite::MatchTrades)
+        {
+            AllocationTracker::site_ = site;
+            AllocationTracker::stats_[static_cast<std::size_t>(site)].calls_++;
+        }
+    }
+
+    ~AllocationScope() { AllocationTracker::site_ = previous_; }
+
+private:
+    AllocationSite previous_;
+#else
+    explicit AllocationScope(AllocationSite) {}
+#endif
+
+public:
+    AllocationScope(const AllocationScope &) = delete;
+    AllocationScope &operator=(const AllocationScope &) = delete;
+};
@@ -0,0 +1,198 @@
+#pragma once
+
+#include <chrono>
+#include <optional>
+#include <random>
+#include <string>
+
+#include "InputHandler.h"
+#include "OrderBookBackend.h"
+
+// randomized differential harness: feeds the same command stream to two book backends and reports the first instruction
+// where their trades, size or levels disagree. also times a backend over a stream so backends can be compared
+
+struct DifferentialMismatch
+{
+    std::size_t instruction_;
+    std::string reason_;
+};
+
+inline OrderPointer ToOrderPointer(const Information &information)
+{
+    return std::make_shared<Order>(information.orderType_, information.orderId_, information.side_, information.price_, information.quantity_);
+}
+
+inline OrderModify ToOrderModify(const Information &information)
+{
+    return OrderModify(information.orderId_, information.side_, information.price_, information.quantity_);
+}
+
+template <OrderBookBackend Book>
+Trades ApplyInformation(Book &book, const Information &information)
+{
+    switch (information.type_)
+    {
+    case ActionType::Add:
+        return book.AddOrder(ToOrderPointer(information));
+    case ActionType::Modify:
+        return book.ModifyOrder(ToOrderModify(information));
+    case ActionType::Cancel:
+        book.CancelOrder(information.orderId_);
+        return {};
+    default:
+        throw std::logic_error("Unsupported Action");
+    }
+}
+
+// generates a command stream over a narrow price band so orders cross often, with modifies and cancels aimed at ids that were issued
+// firstOrderId lets a second stream continue on a book that already holds the orders of a first one
+inline Informations GenerateInformations(std::size_t count, std::uint32_t seed, Price midPrice = 100, Price priceSpread = 5, OrderId firstOrderId = 1)
+{
+    std::mt19937 generator{seed};
+    std::uniform_int_distribution<int> percent{0, 99};
+    std::uniform_int_distribution<Price> price{midPrice - priceSpread, midPrice + priceSpread};
+    std::uniform_int_distribution<Quantity> quantity{1, 20};
+
+    Informations informations;
+    informations.reserve(count);
+    OrderId nextOrderId{firstOrderId};
+
+    auto RandomSide = [&]()
+    { return percent(generator) < 50 ? Side::Buy : Side::Sell; };
+    auto IssuedOrderId = [&]()
+    { return std::uniform_int_distribution<OrderId>{firstOrderId, nextOrderId}(generator); };
+
+    for (std::size_t i = 0; i < count; i++)
+    {
+        Information information{};
+        const auto roll = percent(generator);
+
+        if (roll < 65 || nextOrderId == firstOrderId)
+        {
+            const auto typeRoll = percent(generator);
+            information.type_ = ActionType::Add;
+            information.orderType_ = typeRoll < 55   ? OrderType::GoodTillCancel
+                                     : typeRoll < 70 ? OrderType::GoodForDay
+                                     : typeRoll < 82 ? OrderType::FillAndKill
+                                     : typeRoll < 94 ? OrderType::FillOrKill
+                                                     : OrderType::Market;
+            information.side_ = RandomSide();
+            information.price_ = information.orderType_ == OrderType::Market ? 0 : price(generator);
+            information.quantity_ = quantity(generator);
+            information.orderId_ = nextOrderId++;
+        }
+        else if (roll < 80)
+        {
+            information.type_ = ActionType::Modify;
+            information.orderId_ = IssuedOrderId();
+            information.side_ = RandomSide();
+            information.price_ = price(generator);
+            information.quantity_ = quantity(generator);
+        }
+        else
+        {
+            information.type_ = ActionType::Cancel;
+            information.orderId_ = IssuedOrderId();
+        }
+
+        informations.push_back(information);
+    }
+
+    return informations;
+}
+
+inline std::optional<std::string> CompareTrades(const Trades &left, const Trades &right)
+{
+    if (left.size() != right.size())
+        return "trade count " + std::to_string(left.size()) + " != " + std::to_string(right.size());
+
+    auto SameInfo = [](const TradeInfo &left, const TradeInfo &right)
+    { return left.orderId_ == right.orderId_ && left.price_ == right.price_ && left.quantity_ == right.quantity_; };
+
+    for (std::size_t i = 0; i < left.size(); i++)
+    {
+        if (!SameInfo(left[i].GetBidTrade(), right[i].GetBidTrade()) || !SameInfo(left[i].GetAskTrade(), right[i].GetAskTrade()))
+            return "trade " + std::to_string(i) + " differs";
+    }
+
+    return std::nullopt;
+}
+
+inline std::optional<std::string> CompareLevels(const LevelInfos &left, const LevelInfos &right, const char *side)
+{
+    if (left.size() != right.size())
+        return std::string{side} + " level count " + std::to_string(left.size()) + " != " + std::to_string(right.size());
+
+    for (std::size_t i = 0; i < left.size(); i++)
+    {
+        if (left[i].price_ != right[i].price_ || left[i].quantity_ != right[i].quantity_)
+            return std::string{side} + " level " + std::to_string(i) + " differs at price " + std::to_string(left[i].price_);
+    }
+
+    return std::nullopt;
+}
+
+// the resting orders of two books, by their size and their levels
+template <OrderBookBackend Left, OrderBookBackend Right>
+std::optional<std::string> CompareBooks(const Left &left, const Right &right)
+{
+    if (left.Size() != right.Size())
+        return "size " + std::to_string(left.Size()) + " != " + std::to_string(right.Size());
+
+    const auto leftInfos = left.GetOrderInfos();
+    const auto rightInfos = right.GetOrderInfos();
+
+    if (auto reason = CompareLevels(leftInfos.GetBids(), rightInfos.GetBids(), "bid"))
+        return reason;
+    return CompareLevels(leftInfos.GetAsks(), rightInfos.GetAsks(), "ask");
+}
+
+template <OrderBookBackend Left, OrderBookBackend Right>
+std::optional<DifferentialMismatch> RunDifferential(const Informations &informations)
+{
+    Left left;
+    Right right;
+
+    for (std::size_t i = 0; i < informations.size(); i++)
+    {
+        const auto &information = informations[i];
+
+        if (auto reason = CompareTrades(ApplyInformation(left, information), ApplyInformation(right, information)))
+            return DifferentialMismatch{i, *reason};
+
+        if (auto reason = CompareBooks(left, right))
+            return DifferentialMismatch{i, *reason};
+    }
+
+    return std::nullopt;
+}
+
+// times only the book operations, the add orders are built up front so allocation of the orders is not measured
+template <OrderBookBackend Book>
+std::chrono::nanoseconds TimeBackend(const Informations &informations)
+{
+    std::vector<OrderPointer> orders;
+    orders.reserve(informations.size());
+    for (const auto &information : informations)
+        orders.push_back(information.type_ == ActionType::Add ? ToOrderPointer(information) : nullptr);
+
+    Book book;
+    std::size_t tradeCount{};
+
+    const auto start = std::chrono::steady_clock::now();
+    for (std::size_t i = 0; i < informations.size(); i++)
+    {
+        const auto &information = informations[i];
+        if (information.type_ == ActionType::Add)
+            tradeCount += book.AddOrder(orders[i]).size();
+        else
+            tradeCount += ApplyInformation(book, information).size();
+    }
+    const auto end = std::chrono::steady_clock::now();
+
+    // keep the trade count observable so the loop is not optimised away
+    volatile std::size_t sink = tradeCount;
+    (void)sink;
+
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(end - start);
+}
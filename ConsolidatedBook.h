@@ -0,0 +1,183 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <optional>
+#include <unordered_map>
+#include <vector>
+
+#include "Usings.h"
+#include "Side.h"
+#include "LevelInfo.h"
+#include "OrderBookLevelInfos.h"
+#include "MarketDataRing.h"
+
+// merged depth across several books for the same instrument, one per venue or liquidity pool. it follows the level changes each book
+// publishes to its market data ring and keeps one ladder per side with the quantity summed over all books, so the consolidated best
+// bid and offer is the front of a map and the top n levels are its first n entries, nothing is merged at query time.
+// a ConsolidatedBook is meant to be used from a single thread, the books publish from their own
+class ConsolidatedBook
+{
+public:
+    // follows a book from the next event it publishes, returns the source index. the book should be empty, or be resynced
+    std::size_t AddSource(const MarketDataRing &ring)
+    {
+        auto &source = sources_.emplace_back();
+        source.subscriber_.emplace(ring);
+        return sources_.size() - 1;
+    }
+
+    // a source fed directly through OnLevel rather than from a ring
+    std::size_t AddSource()
+    {
+        sources_.emplace_back();
+        return sources_.size() - 1;
+    }
+
+    // applies every level change published since the last poll and returns how many events were read. a source whose ring lapped
+    // it stops being read until it is resynced
+    std::size_t Poll()
+    {
+        std::size_t count = 0;
+        MarketDataEvent event;
+
+        for (std::size_t index = 0; index < sources_.size(); index++)
+        {
+            auto &source = sources_[index];
+            if (!source.subscriber_ || source.needsResync_)
+                continue;
+
+            while (true)
+            {
+                const auto status = source.subscriber_->TryRead(event);
+                if (status == MarketDataSubscriber::ReadStatus::Empty)
+                    break;
+                if (status == MarketDataSubscriber::ReadStatus::Overrun)
+                {
+                    source.needsResync_ = true;
+                    break;
+                }
+
+                count++;
+                if (event.type_ == MarketDataType::Level)
+                    OnLevel(index, event.side_, event.price_, event.quantity_);
+            }
+        }
+
+        return count;
+    }
+
+    bool NeedsResync(std::size_t source) const { return sources_[source].needsResync_; }
+
+    // replaces what a source contributes with a snapshot of its book. the ring is followed again from its newest event before
+    // the snapshot is taken, level changes carry the new total so replaying the ones the snapshot already holds changes nothing
+    template <typename Book>
+    void Resync(std::size_t index, const Book &book)
+    {
+        auto &source = sources_[index];
+        if (source.subscriber_)
+        {
+            const auto &ring = source.subscriber_->GetRing();
+            source.subscriber_.reset();
+            source.subscriber_.emplace(ring);
+        }
+
+        for (const auto &[price, quantity] : source.bids_)
+            AddQuantity(bids_, price, -static_cast<std::int64_t>(quantity));
+        for (const auto &[price, quantity] : source.asks_)
+            AddQuantity(asks_, price, -static_cast<std::int64_t>(quantity));
+        source.bids_.clear();
+        source.asks_.clear();
+        source.needsResync_ = false;
+
+        const auto snapshot = book.GetOrderInfos();
+        for (const auto &level : snapshot.GetBids())
+            OnLevel(index, Side::Buy, level.price_, level.quantity_);
+        for (const auto &level : snapshot.GetAsks())
+            OnLevel(index, Side::Sell, level.price_, level.quantity_);
+    }
+
+    // a source's quantity at one price on one side is now quantity, only the difference touches the merged ladder
+    void OnLevel(std::size_t index, Side side, Price price, Quantity quantity)
+    {
+        auto &source = sources_[index];
+        auto &levels = side == Side::Buy ? source.bids_ : source.asks_;
+
+        std::int64_t change = quantity;
+        if (auto level = levels.find(price); level != levels.end())
+        {
+            change -= level->second;
+            if (quantity == 0)
+                levels.erase(level);
+            else
+                level->second = quantity;
+        }
+        else if (quantity != 0)
+        {
+            levels.emplace(price, quantity);
+        }
+
+        if (change == 0)
+            return;
+
+        if (side == Side::Buy)
+            AddQuantity(bids_, price, change);
+        else
+            AddQuantity(asks_, price, change);
+    }
+
+    std::optional<LevelInfo> GetBestBid() const { return GetBest(bids_); }
+    std::optional<LevelInfo> GetBestAsk() const { return GetBest(asks_); }
+
+    // the best depth levels of each side, best first
+    LevelInfos GetBids(std::size_t depth) const { return GetDepth(bids_, depth); }
+    LevelInfos GetAsks(std::size_t depth) const { return GetDepth(asks_, depth); }
+
+    std::size_t GetSourceCount() const { return sources_.size(); }
+
+private:
+    struct Source
+    {
+        std::optional<MarketDataSubscriber> subscriber_;
+        // this source's own quantity per price, to work out how much a level change moves the merged level
+        std::unordered_map<Price, Quantity> bids_;
+        std::unordered_map<Price, Quantity> asks_;
+        bool needsResync_{false};
+    };
+
+    template <typename Ladder>
+    static void AddQuantity(Ladder &ladder, Price price, std::int64_t change)
+    {
+        auto level = ladder.try_emplace(price, 0).first;
+        level->second += change;
+        if (level->second == 0)
+            ladder.erase(level);
+    }
+
+    template <typename Ladder>
+    static std::optional<LevelInfo> GetBest(const Ladder &ladder)
+    {
+        if (ladder.empty())
+            return std::nullopt;
+        const auto &[price, quantity] = *ladder.begin();
+        return LevelInfo{price, static_cast<Quantity>(quantity)};
+    }
+
+    template <typename Ladder>
+    static LevelInfos GetDepth(const Ladder &ladder, std::size_t depth)
+    {
+        LevelInfos levels;
+        levels.reserve(std::min(depth, ladder.size()));
+        for (auto level = ladder.begin(); level != ladder.end() && levels.size() < depth; ++level)
+            levels.push_back(LevelInfo{level->first, static_cast<Quantity>(level->second)});
+        return levels;
+    }
+
+    std::vector<Source> sources_;
+    // merged quantity per price, summed over every source, kept in 64 bits so several books cannot overflow it
+    std::map<Price, std::int64_t, std::greater<Price>> bids_;
+    std::map<Price, std::int64_t, std::less<Price>> asks_;
+};
@@ -1,7 +1,11 @@
 #pragma once
 #include "Usings.h"
 
+#include <limits>
+
 struct Constants
 {
     static const Price InvalidPrice = std::numeric_limits<Price>::quiet_NaN();
+    // orders without an owner are not tracked in the owner index
+    static const OwnerId NoOwner = 0;
 };
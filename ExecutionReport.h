@@ -0,0 +1,117 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <vector>
+
+#include "Usings.h"
+#include "Side.h"
+#include "Order.h"
+#include "OrderStatus.h"
+#include "MatchingPolicy.h"
+
+template <MatchingPolicy Policy>
+class BasicOrderBook;
+
+// one fill against a resting order, the incoming side of it is only written once, in the summary
+struct FillNotice
+{
+    OrderId restingOrderId_;
+    Price price_;
+    Quantity quantity_;
+};
+
+static_assert(sizeof(FillNotice) == 16, "a fill notice is half the size of a Trade");
+
+// what happened to one incoming order, its fills are fillCount_ notices from firstFill_ on
+struct ExecutionSummary
+{
+    OrderId orderId_;
+    Side side_;
+    // the remainder rests in the book, false once the order filled or was cancelled as fill and kill
+    bool resting_{false};
+    // why the book turned the order down, a rejected order has no fills and its whole quantity remaining
+    OrderStatus status_{};
+    Quantity filledQuantity_{};
+    Quantity remainingQuantity_{};
+    std::uint32_t levelsSwept_{};
+    std::uint32_t firstFill_{};
+    std::uint32_t fillCount_{};
+    // sum of price * quantity, for the average price
+    std::int64_t notional_{};
+
+    double GetAveragePrice() const { return filledQuantity_ == 0 ? 0.0 : static_cast<double>(notional_) / filledQuantity_; }
+};
+
+// the book's output for orders entered in execution report mode: one summary per incoming order instead of a Trade per fill
+// that repeats the incoming order every time. summaries and fills sit in two vectors that are reserved up front and only
+// cleared between uses, so a report that stays within its reserve never allocates
+class ExecutionReport
+{
+public:
+    ExecutionReport(std::size_t maxOrders, std::size_t maxFills)
+    {
+        summaries_.reserve(maxOrders);
+        fills_.reserve(maxFills);
+    }
+
+    // forgets the reported orders, the memory is kept
+    void Clear()
+    {
+        summaries_.clear();
+        fills_.clear();
+    }
+
+    const std::vector<ExecutionSummary> &GetSummaries() const { return summaries_; }
+    const std::vector<FillNotice> &GetFills() const { return fills_; }
+    std::span<const FillNotice> GetFills(const ExecutionSummary &summary) const { return {fills_.data() + summary.firstFill_, summary.fillCount_}; }
+
+private:
+    template <MatchingPolicy Policy>
+    friend class BasicOrderBook;
+
+    void BeginOrder(const Order &order)
+    {
+        summaries_.push_back(ExecutionSummary{order.GetOrderId(), order.GetSide()});
+        summaries_.back().remainingQuantity_ = order.GetRemainingQuantity();
+        summaries_.back().firstFill_ = static_cast<std::uint32_t>(fills_.size());
+    }
+
+    // the incoming order is the one that began last. a repriced peg that crosses can be an aggressor without having been entered,
+    // its fills get a summary of their own
+    void OnFill(const Order &aggressor, OrderId restingOrderId, Price price, Quantity quantity)
+    {
+        if (summaries_.empty() || summaries_.back().orderId_ != aggressor.GetOrderId())
+            BeginOrder(aggressor);
+
+        auto &summary = summaries_.back();
+        if (summary.fillCount_ == 0 || fills_.back().price_ != price)
+            summary.levelsSwept_++;
+        summary.filledQuantity_ += quantity;
+        summary.notional_ += static_cast<std::int64_t>(price) * quantity;
+        summary.remainingQuantity_ = aggressor.GetRemainingQuantity();
+        summary.resting_ = !aggressor.IsFilled();
+        summary.fillCount_++;
+
+        fills_.push_back(FillNotice{restingOrderId, price, quantity});
+    }
+
+    void RejectOrder(OrderId orderId, Side side, Quantity quantity, const OrderStatus &status)
+    {
+        summaries_.push_back(ExecutionSummary{orderId, side});
+        summaries_.back().status_ = status;
+        summaries_.back().remainingQuantity_ = quantity;
+        summaries_.back().firstFill_ = static_cast<std::uint32_t>(fills_.size());
+    }
+
+    void EndOrder(const Order &order, bool resting)
+    {
+        auto &summary = summaries_.back();
+        summary.remainingQuantity_ = order.GetRemainingQuantity();
+        summary.resting_ = resting;
+    }
+
+    std::vector<ExecutionSummary> summaries_;
+    std::vector<FillNotice> fills_;
+};
@@ -61,6 +61,13 @@ bool InputHandler::TryParseInformation(const std::string_view &str, Information
         information.orderId_ = ParseOrderId(values[1]);
     }
 
+    // Time stamp, every command after it happened at this time
+    else if (action == 'T')
+    {
+        information.type_ = ActionType::Time;
+        information.timestamp_ = ParseTimestamp(values[1]);
+    }
+
     else
         return false;
 
@@ -140,11 +147,17 @@ OrderId InputHandler::ParseOrderId(const std::string_view &str) const
     return static_cast<OrderId>(ToNumber(str));
 }
 
-std::tuple<Informations, Result> InputHandler::GetInformationsAndResult(const std::filesystem::path &path) const
+std::int64_t InputHandler::ParseTimestamp(const std::string_view &str) const
 {
-    Informations informations;
-    informations.reserve(1'000);
+    std::int64_t value{};
+    const auto [end, error] = std::from_chars(str.data(), str.data() + str.size(), value);
+    if (str.empty() || error != std::errc{} || end != str.data() + str.size() || value < 0)
+        throw std::logic_error("Invalid Timestamp");
+    return value;
+}
 
+Result InputHandler::StreamInformations(const std::filesystem::path &path, const std::function<void(const Information &)> &onInformation) const
+{
     std::string line;
     std::ifstream file{path};
 
@@ -166,7 +179,7 @@ std::tuple<Informations, Result> InputHandler::GetInformationsAndResult(const st
             {
                 throw std::logic_error("One of the information line specified is invalid!");
             }
-            informations.push_back(information);
+            onInformation(information);
         }
 
         else
@@ -181,13 +194,23 @@ std::tuple<Informations, Result> InputHandler::GetInformationsAndResult(const st
             {
                 break;
             }
-            return {informations, result};
+            return result;
         }
     }
 
     throw std::logic_error("Invalid Result Line");
 };
 
+std::tuple<Informations, Result> InputHandler::GetInformationsAndResult(const std::filesystem::path &path) const
+{
+    Informations informations;
+    informations.reserve(1'000);
+
+    const auto result = StreamInformations(path, [&informations](const Information &information)
+                                           { informations.push_back(information); });
+    return {informations, result};
+};
+
 // class OrderBookTextFixture : public googletest::TestWithParam<const char *>
 // {
 // private:
@@ -5,6 +5,8 @@
 #include <fstream>
 #include <vector>
 #include <string_view>
+#include <functional>
+#include <tuple>
 
 #include "OrderBook.h"
 
@@ -12,7 +14,9 @@ enum class ActionType
 {
     Add,
     Modify,
-    Cancel
+    Cancel,
+    // advances a simulated clock, the timestamp is in nanoseconds since the epoch
+    Time
 };
 
 struct Information
@@ -23,6 +27,7 @@ struct Information
     Price price_;
     Quantity quantity_;
     OrderId orderId_;
+    std::int64_t timestamp_;
 };
 
 using Informations = std::vector<Information>;
@@ -46,7 +51,10 @@ private:
     Price ParsePrice(const std::string_view &str) const;
     Quantity ParseQuantity(const std::string_view &str) const;
     OrderId ParseOrderId(const std::string_view &str) const;
+    std::int64_t ParseTimestamp(const std::string_view &str) const;
 
 public:
+    // reads the file one line at a time, handing each information to the callback as soon as it is parsed, so memory use does not grow with the file
+    Result StreamInformations(const std::filesystem::path &path, const std::function<void(const Information &)> &onInformation) const;
     std::tuple<Informations, Result> GetInformationsAndResult(const std::filesystem::path &path) const;
 };
@@ -0,0 +1,204 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <new>
+#include <stdexcept>
+
+#include "Usings.h"
+#include "Side.h"
+#include "Trade.h"
+
+// single producer, multi consumer broadcast ring for market data, laid out so it can live in shared memory.
+// the publisher never waits on readers: every slot carries the sequence number of the event in it, and a reader that
+// finds a newer sequence than the one it expected knows it was lapped and has to resync
+
+enum class MarketDataType : std::uint8_t
+{
+    Trade,
+    Level,
+};
+
+struct MarketDataEvent
+{
+    MarketDataType type_;
+    Side side_;
+    std::uint8_t reserved_[2];
+    // the level price for a level change, the bid order's price for a trade
+    Price price_;
+    // traded quantity for a trade, the new total quantity on that side of the price level for a level change
+    Quantity quantity_;
+    // the ask order's price, only set for a trade
+    Price askPrice_;
+    OrderId bidOrderId_;
+    OrderId askOrderId_;
+    // steady clock time the event was published at, in nanoseconds
+    std::uint64_t publishTimestamp_;
+};
+
+static_assert(sizeof(MarketDataEvent) % sizeof(std::uint64_t) == 0, "MarketDataEvent is copied a word at a time");
+static_assert(std::atomic<std::uint64_t>::is_always_lock_free, "the ring relies on lock free 64 bit atomics across processes");
+
+class MarketDataRing
+{
+public:
+    static constexpr std::uint64_t Magic = 0x4f42'4d44'5249'4e47; // "OBMDRING"
+    static constexpr std::size_t EventWords = sizeof(MarketDataEvent) / sizeof(std::uint64_t);
+
+    // one slot per cache line, sequence 0 marks a slot that is empty or being written
+    struct alignas(64) Slot
+    {
+        std::atomic<std::uint64_t> sequence_;
+        std::array<std::atomic<std::uint64_t>, EventWords> words_;
+    };
+
+    static std::size_t GetRequiredSize(std::size_t capacity) { return sizeof(MarketDataRing) + capacity * sizeof(Slot); }
+
+    // builds an empty ring in memory of at least GetRequiredSize(capacity) bytes
+    static MarketDataRing &Initialize(void *memory, std::size_t capacity)
+    {
+        if (capacity == 0 || (capacity & (capacity - 1)) != 0)
+            throw std::logic_error("Market data ring capacity must be a power of two");
+
+        auto *ring = new (memory) MarketDataRing{capacity};
+        for (std::size_t i = 0; i < capacity; i++)
+            new (&ring->GetSlot(i)) Slot{};
+
+        ring->magic_ = Magic;
+        return *ring;
+    }
+
+    // attaches to a ring another process initialized
+    static const MarketDataRing &Attach(const void *memory)
+    {
+        const auto *ring = static_cast<const MarketDataRing *>(memory);
+        if (ring->magic_ != Magic)
+            throw std::logic_error("Memory does not hold an initialized market data ring");
+        return *ring;
+    }
+
+    std::size_t GetCapacity() const { return capacity_; }
+    std::uint64_t GetWriteSequence() const { return writeSequence_.load(std::memory_order_acquire); }
+
+    Slot &GetSlot(std::uint64_t sequence) { return GetSlots()[sequence & (capacity_ - 1)]; }
+    const Slot &GetSlot(std::uint64_t sequence) const { return GetSlots()[sequence & (capacity_ - 1)]; }
+
+private:
+    friend class MarketDataPublisher;
+
+    explicit MarketDataRing(std::size_t capacity) : capacity_{capacity} {}
+
+    Slot *GetSlots() { return reinterpret_cast<Slot *>(reinterpret_cast<char *>(this) + sizeof(MarketDataRing)); }
+    const Slot *GetSlots() const { return reinterpret_cast<const Slot *>(reinterpret_cast<const char *>(this) + sizeof(MarketDataRing)); }
+
+    std::uint64_t magic_{};
+    std::uint64_t capacity_;
+    alignas(64) std::atomic<std::uint64_t> writeSequence_{0};
+};
+
+class MarketDataPublisher
+{
+public:
+    explicit MarketDataPublisher(MarketDataRing &ring) : ring_{ring}, sequence_{ring.GetWriteSequence()} {}
+
+    void PublishTrade(const Trade &trade)
+    {
+        const auto &bid = trade.GetBidTrade();
+        const auto &ask = trade.GetAskTrade();
+        Publish(MarketDataEvent{MarketDataType::Trade, Side::Buy, {}, bid.price_, bid.quantity_, ask.price_, bid.orderId_, ask.orderId_, 0});
+    }
+
+    void PublishLevel(Side side, Price price, Quantity quantity)
+    {
+        Publish(MarketDataEvent{MarketDataType::Level, side, {}, price, quantity, 0, 0, 0, 0});
+    }
+
+private:
+    void Publish(MarketDataEvent event)
+    {
+        event.publishTimestamp_ = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+
+        std::array<std::uint64_t, MarketDataRing::EventWords> words;
+        std::memcpy(words.data(), &event, sizeof(MarketDataEvent));
+
+        const auto sequence = ++sequence_;
+        auto &slot = ring_.GetSlot(sequence);
+
+        // mark the slot as being written before touching the payload, so a reader racing with us sees the change
+        slot.sequence_.store(0, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+        for (std::size_t i = 0; i < words.size(); i++)
+            slot.words_[i].store(words[i], std::memory_order_relaxed);
+        slot.sequence_.store(sequence, std::memory_order_release);
+
+        ring_.writeSequence_.store(sequence, std::memory_order_release);
+    }
+
+    MarketDataRing &ring_;
+    std::uint64_t sequence_;
+};
+
+class MarketDataSubscriber
+{
+public:
+    enum class ReadStatus
+    {
+        Ok,
+        Empty,
+        Overrun,
+    };
+
+    // starts with the next event to be published
+    explicit MarketDataSubscriber(const MarketDataRing &ring) : ring_{ring}, nextSequence_{ring.GetWriteSequence() + 1} {}
+
+    ReadStatus TryRead(MarketDataEvent &event)
+    {
+        // the write sequence is read first: once it covers our event, the slot can only hold our event or a newer one
+        if (ring_.GetWriteSequence() < nextSequence_)
+            return ReadStatus::Empty;
+
+        const auto &slot = ring_.GetSlot(nextSequence_);
+        if (slot.sequence_.load(std::memory_order_acquire) != nextSequence_)
+            return ReadStatus::Overrun;
+
+        std::array<std::uint64_t, MarketDataRing::EventWords> words;
+        for (std::size_t i = 0; i < words.size(); i++)
+            words[i] = slot.words_[i].load(std::memory_order_relaxed);
+
+        // the publisher lapped us while we were copying
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (slot.sequence_.load(std::memory_order_relaxed) != nextSequence_)
+            return ReadStatus::Overrun;
+
+        std::memcpy(&event, words.data(), sizeof(MarketDataEvent));
+        nextSequence_++;
+        return ReadStatus::Ok;
+    }
+
+    // after an overrun, skip to the oldest event that is still safe to read and count what was lost
+    void Resync()
+    {
+        const auto writeSequence = ring_.GetWriteSequence();
+        // leave half the ring as headroom so the publisher does not lap us again straight away
+        const auto oldest = writeSequence > ring_.GetCapacity() / 2 ? writeSequence - ring_.GetCapacity() / 2 + 1 : 1;
+
+        if (oldest > nextSequence_)
+        {
+            missedCount_ += oldest - nextSequence_;
+            nextSequence_ = oldest;
+        }
+    }
+
+    const MarketDataRing &GetRing() const { return ring_; }
+    std::uint64_t GetNextSequence() const { return nextSequence_; }
+    std::uint64_t GetMissedCount() const { return missedCount_; }
+
+private:
+    const MarketDataRing &ring_;
+    std::uint64_t nextSequence_;
+    std::uint64_t missedCount_{};
+};
@@ -0,0 +1,65 @@
+#pragma once
+
+#include <concepts>
+#include <cstddef>
+#include <cstdint>
+
+#include "Usings.h"
+
+// how an incoming order's quantity is shared out among the resting orders of the level it trades against.
+// the policy is a template parameter of the book, so a FIFO book compiles the same matching loop it always had
+
+// strict price time priority, the oldest resting order fills first
+struct FifoMatching
+{
+    static constexpr bool ProRata = false;
+    static constexpr bool TopOrderPriority = false;
+};
+
+// the incoming quantity is split across the level in proportion to each resting order's remaining quantity
+struct ProRataMatching
+{
+    static constexpr bool ProRata = true;
+    static constexpr bool TopOrderPriority = false;
+};
+
+// the oldest resting order fills first, whatever is left is split pro rata across the rest of the level
+struct HybridMatching
+{
+    static constexpr bool ProRata = true;
+    static constexpr bool TopOrderPriority = true;
+};
+
+template <typename Policy>
+concept MatchingPolicy = requires {
+    { Policy::ProRata } -> std::convertible_to<bool>;
+    { Policy::TopOrderPriority } -> std::convertible_to<bool>;
+};
+
+// splits quantity across count resting orders in proportion to their quantities, quantity has to be below levelQuantity.
+// each order gets its share rounded down, quantities[i] * quantity / levelQuantity, and the lots left over go one at a time to
+// the orders in time priority, so the result is deterministic. the share is taken with a 32 bit fixed point ratio so the main
+// pass is a branch free multiply, shift and compare the compiler can vectorize
+inline void AllocateProRata(const Quantity *quantities, Quantity *allocations, std::size_t count, std::uint64_t levelQuantity, Quantity quantity)
+{
+    const std::uint64_t ratio = (static_cast<std::uint64_t>(quantity) << 32) / levelQuantity;
+
+    Quantity allocated = 0;
+    for (std::size_t i = 0; i < count; i++)
+    {
+        // the truncated ratio can leave the share one lot under the rounded down one, never more, and the compare adds it back
+        const auto allocation = static_cast<Quantity>((quantities[i] * ratio) >> 32);
+        allocations[i] = allocation + ((allocation + 1) * levelQuantity <= static_cast<std::uint64_t>(quantities[i]) * quantity);
+        allocated += allocations[i];
+    }
+
+    // a rounded down share is below the order's quantity and fewer than count lots are left over, so one pass hands them out
+    for (std::size_t i = 0; allocated < quantity; i = (i + 1) % count)
+    {
+        if (allocations[i] < quantities[i])
+        {
+            allocations[i]++;
+            allocated++;
+        }
+    }
+}
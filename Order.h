@@ -6,12 +6,21 @@
 #include "Constants.h"
 
 #include <list>
+#include <memory_resource>
+#include <memory>
+#include <cstddef>
+#include <cstdint>
 #include <exception>
+#include <stdexcept>
 
-class Order
+// the fields of the order record are ordered so that the ones the matching loop touches on every fill (remaining quantity, price,
+// id, side) sit together at the front, and the rest (order type, risk slot, initial quantity, owner, queue sequence) sit behind
+// them in the same record. the record is aligned to 32 bytes so that a single order never straddles a cache line,
+// tools/BookCompare.cpp counts the cache misses per matched order
+class alignas(32) Order
 {
 public:
-    Order(OrderType orderType, OrderId orderId, Side side, Price price, Quantity quantity) : orderType_{orderType}, orderId_{orderId}, side_{side}, price_{price}, initialQuantity_{quantity}, remainingQuantity_{quantity}
+    Order(OrderType orderType, OrderId orderId, Side side, Price price, Quantity quantity, OwnerId ownerId = Constants::NoOwner) : remainingQuantity_{quantity}, price_{price}, orderId_{orderId}, side_{side}, orderType_{orderType}, initialQuantity_{quantity}, ownerId_{ownerId}
     {
     }
 
@@ -25,6 +34,7 @@ public:
     Price GetPrice() const { return price_; }
     OrderType GetOrderType() const { return orderType_; }
     Quantity GetIntialQuantity() const { return initialQuantity_; }
+    OwnerId GetOwnerId() const { return ownerId_; }
     Quantity GetRemainingQuantity() const { return remainingQuantity_; }
     Quantity GetFilledQuantity() const { return initialQuantity_ - remainingQuantity_; }
     bool IsFilled() const { return GetRemainingQuantity() == 0; }
@@ -36,6 +46,15 @@ public:
         };
         remainingQuantity_ -= quantity;
     }
+    // changes the quantity still open without counting it as a fill
+    void Resize(Quantity remainingQuantity)
+    {
+        initialQuantity_ = GetFilledQuantity() + remainingQuantity;
+        remainingQuantity_ = remainingQuantity;
+    }
+    // position in the order's price level, assigned by the book whenever the order joins or the level is renumbered
+    std::uint32_t GetQueueSequence() const { return queueSequence_; }
+    void SetQueueSequence(std::uint32_t queueSequence) { queueSequence_ = queueSequence; }
     void ToGoodTillCancel(Price price)
     {
         if (GetOrderType() != OrderType::Market)
@@ -43,15 +62,43 @@ public:
         price_ = price;
         orderType_ = OrderType::GoodTillCancel;
     }
+    // a pegged order follows its reference price, the book moves it to the new level before changing its price
+    void Reprice(Price price) { price_ = price; }
+    // the owner's entry in the risk gate's table, stored by the gate when it checks the order, 0 when the owner has no limits
+    std::uint16_t GetRiskSlot() const { return riskSlot_; }
+    void SetRiskSlot(std::uint16_t riskSlot) { riskSlot_ = riskSlot; }
 
 private:
-    OrderType orderType_;
+    friend struct OrderLayout;
+
+    // hot fields, read or written for every matched order
+    Quantity remainingQuantity_;
+    Price price_;
     OrderId orderId_;
     Side side_;
-    Price price_;
+
+    // colder fields, only read when an order is added, modified, reported or mass cancelled. they share the hot fields' cache line
+    OrderType orderType_;
+    std::uint16_t riskSlot_{};
     Quantity initialQuantity_;
-    Quantity remainingQuantity_;
+    OwnerId ownerId_;
+    // read on fills and cancels
+    std::uint32_t queueSequence_{};
+};
+
+// compile time checks on the order of the record's fields, so a reorder that pushes hot data apart fails the build
+struct OrderLayout
+{
+    static constexpr std::size_t CacheLineSize = 64;
+    static constexpr std::size_t HotSize = offsetof(Order, side_) + sizeof(Side);
+
+    static_assert(alignof(Order) == 32, "Order must be aligned so it never straddles a cache line");
+    static_assert(sizeof(Order) == 32, "Order must fit in half a cache line");
+    static_assert(CacheLineSize % alignof(Order) == 0, "Order alignment must divide the cache line size");
+    static_assert(offsetof(Order, remainingQuantity_) == 0, "remaining quantity must be the first hot field");
+    static_assert(HotSize <= 24, "hot fields must be packed at the front of the record");
+    static_assert(offsetof(Order, orderType_) >= HotSize && offsetof(Order, riskSlot_) >= HotSize && offsetof(Order, initialQuantity_) >= HotSize && offsetof(Order, ownerId_) >= HotSize && offsetof(Order, queueSequence_) >= HotSize, "cold fields must sit behind the hot fields");
 };
 
 using OrderPointer = std::shared_ptr<Order>;
-using OrderPointers = std::list<OrderPointer>;
\ No newline at end of file
+using OrderPointers = std::pmr::list<OrderPointer>;
\ No newline at end of file
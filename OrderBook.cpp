@@ -1,128 +1,532 @@
-#include "Orderbook.h"
+#include "OrderBook.h"
+#include "MarketDataRing.h"
+#include "AllocationTracker.h"
 
 #include <numeric>
+#include <limits>
+#include <algorithm>
+#include <bit>
 #include <chrono>
 #include <ctime>
 #include <mutex>
 #include <optional>
+#include <utility>
 #include <iostream>
 
-void OrderBook::PruneGoodForDayOrders()
+template <MatchingPolicy Policy>
+std::pmr::pool_options BasicOrderBook<Policy>::MakeNodePoolOptions(const OrderBookCapacity &capacity)
 {
-    using namespace std::chrono;
-    const auto end = hours(16);
-    while (true)
+    // the queue indexes of deep levels are the largest blocks the book allocates, keep them pooled too
+    std::pmr::pool_options options;
+    if (capacity.maxOrders_ != 0)
+        options.largest_required_pool_block = LevelQueueIndex::GetAllocationSize(std::bit_ceil(std::max<std::size_t>(2 * capacity.maxOrders_, MinQueueCapacity)));
+    return options;
+}
+
+template <MatchingPolicy Policy>
+BasicOrderBook<Policy>::BasicOrderBook(const OrderBookCapacity &capacity)
+    : nodeResource_{MakeNodePoolOptions(capacity)}
+{
+    orders_.reserve(capacity.maxOrders_);
+    data_.reserve(capacity.maxLevels_);
+    owners_.reserve(capacity.maxOwners_);
+    handleSlots_.reserve(capacity.maxOrders_);
+    if constexpr (Policy::ProRata)
+    {
+        proRataQuantities_.reserve(capacity.maxOrders_);
+        proRataAllocations_.reserve(capacity.maxOrders_);
+    }
+
+    // run every node pool up to capacity once and release the nodes again, the pool keeps them for the real containers
     {
-        const auto now = system_clock::now();
-        // convert the time to a time_t value, representing the seconds since the epoch
-        const auto now_c = system_clock::to_time_t(now);
-        std::tm now_parts;
-        // breaks the time_t into a std::tm structure, which represents the data and time in year, month, day , hour, minute, second
-        localtime_s(&now_parts, &now_c);
+        OrderPointers orders{&nodeResource_};
+        orders.resize(capacity.maxOrders_);
 
-        if (now_parts.tm_hour >= end.count())
+        std::pmr::unordered_map<OrderId, OrderEntry> entries{&nodeResource_};
+        std::vector<OrderPointer> modifiedOrders;
+        modifiedOrders.reserve(capacity.maxOrders_);
+        for (std::size_t i = 0; i < capacity.maxOrders_; i++)
         {
-            // Already past 4pm today, set the target time for 4pm tomorrow
-            now_parts.tm_mday += 1;
+            entries.emplace(i, OrderEntry{});
+            modifiedOrders.push_back(OrderModify(i, Side::Buy, 0, 0).ToOrderPointer(OrderType::GoodTillCancel, Constants::NoOwner, &orderResource_));
         }
 
-        // Get the exact time for 4PM
-        now_parts.tm_hour = end.count();
-        now_parts.tm_min = 0;
-        now_parts.tm_sec = 0;
-
-        // Convert the std::tm back to a time_point
-        auto next = system_clock::from_time_t(mktime(&now_parts));
-        auto till = next - now + milliseconds(100);
-
+        std::pmr::map<Price, PriceLevel, std::greater<Price>> levels{&nodeResource_};
+        std::pmr::unordered_map<Price, LevelData> levelData{&nodeResource_};
+        for (std::size_t i = 0; i < capacity.maxLevels_; i++)
         {
-            std::unique_lock<std::mutex> ordersLock{ordersMutex_};
-
-            if (shutdown_.load(std::memory_order_acquire) || shutdownConditionVariable_.wait_for(ordersLock, till) == std::cv_status::no_timeout)
-                return;
+            levels.try_emplace(static_cast<Price>(i)).first->second.queue_.Reset(MinQueueCapacity);
+            levelData[static_cast<Price>(i)];
         }
 
-        OrderIds orderIds;
-        // get the mutex and then get all the good for day trades, and call cancel orders on them
+        // a level's queue index can grow up to twice the most orders the book holds, one block of every size it can take
+        for (std::size_t queueCapacity = MinQueueCapacity; queueCapacity <= 2 * capacity.maxOrders_; queueCapacity *= 2)
         {
-            std::scoped_lock ordersLock{ordersMutex_};
-
-            for (const auto &[orderId, orderEntry] : orders_)
-            {
-                const auto &[order, _] = orderEntry;
-                if (order->GetOrderType() != OrderType::GoodForDay)
-                {
-                    continue;
-                }
-                orderIds.push_back(order->GetOrderId());
-            }
+            LevelQueueIndex{&nodeResource_}.Reset(queueCapacity);
         }
 
-        CancelOrders(orderIds);
+        std::pmr::unordered_map<OwnerId, OwnerOrders> owners{&nodeResource_};
+        for (std::size_t i = 0; i < capacity.maxOwners_; i++)
+            owners[static_cast<OwnerId>(i)];
+    }
+
+    // the wall clock expires good for day orders from a thread that sleeps until the session close
+    ordersPruneThread_ = std::thread{[this] { PruneGoodForDayOrders(); }};
+}
+
+template <MatchingPolicy Policy>
+BasicOrderBook<Policy>::~BasicOrderBook()
+{
+    StopPruneThread();
+}
+
+template <MatchingPolicy Policy>
+void BasicOrderBook<Policy>::StopPruneThread()
+{
+    if (!ordersPruneThread_.joinable())
+        return;
+
+    // set under the lock, the thread checks it and starts waiting without letting go of the lock in between
+    {
+        std::scoped_lock ordersLock{ordersMutex_};
+        shutdown_.store(true, std::memory_order_release);
+    }
+    shutdownConditionVariable_.notify_one();
+    ordersPruneThread_.join();
+}
+
+template <MatchingPolicy Policy>
+void BasicOrderBook<Policy>::PruneGoodForDayOrders()
+{
+    using namespace std::chrono;
+
+    std::unique_lock<std::mutex> ordersLock{ordersMutex_};
+    while (true)
+    {
+        const auto now = clock_.Now();
+        const auto till = clock_.GetNextSessionEnd(now) - now + milliseconds(100);
+
+        // the predicate keeps a spurious wake up from being taken for a shutdown
+        if (shutdownConditionVariable_.wait_for(ordersLock, till, [this] { return shutdown_.load(std::memory_order_acquire); }))
+            return;
+
+        ExpireGoodForDayOrders();
     }
 };
 
-void OrderBook::CancelOrders(OrderIds orderIds)
+template <MatchingPolicy Policy>
+OrderIds BasicOrderBook<Policy>::ExpireGoodForDayOrders()
 {
-    std::scoped_lock ordersLock{ordersMutex_};
+    // collected first since cancelling erases from orders_, and sorted so the cancels do not depend on the hash order
+    OrderIds orderIds;
+    for (const auto &[orderId, orderEntry] : orders_)
+    {
+        if (orderEntry.order_->GetOrderType() == OrderType::GoodForDay)
+            orderIds.push_back(orderId);
+    }
+    std::sort(orderIds.begin(), orderIds.end());
 
     for (const auto &orderId : orderIds)
     {
         CancelOrderInternal(orderId);
     }
+    RepricePegs(pegTrades_);
+
+    return orderIds;
 }
 
-void OrderBook::CancelOrderInternal(OrderId orderId)
+template <MatchingPolicy Policy>
+void BasicOrderBook<Policy>::UseSimulatedClock(SessionClock::Clock::time_point start, std::chrono::nanoseconds sessionClose)
 {
-    if (orders_.count(orderId) == 0)
+    // simulated time expires orders inline, the thread sleeping on the wall clock is not needed any more
+    StopPruneThread();
+
+    std::scoped_lock ordersLock{ordersMutex_};
+    clock_ = SessionClock::Simulated(start, sessionClose);
+    nextSessionEnd_ = clock_.GetNextSessionEnd(start);
+}
+
+template <MatchingPolicy Policy>
+OrderIds BasicOrderBook<Policy>::AdvanceTime(SessionClock::Clock::time_point now)
+{
+    std::scoped_lock ordersLock{ordersMutex_};
+
+    if (!clock_.IsSimulated())
+        throw std::logic_error("Only a simulated clock can be advanced");
+
+    // no good for day order survives the close, so a jump over several closes only has to expire once
+    OrderIds orderIds;
+    if (now >= nextSessionEnd_)
+    {
+        clock_.Advance(nextSessionEnd_);
+        tradeAnalytics_.CloseElapsedBars(clock_.Now());
+        orderIds = ExpireGoodForDayOrders();
+        nextSessionEnd_ = clock_.GetNextSessionEnd(now);
+    }
+    clock_.Advance(now);
+    // the bars time has moved past are closed here rather than by the next trade
+    tradeAnalytics_.CloseElapsedBars(clock_.Now());
+
+    return orderIds;
+}
+
+template <MatchingPolicy Policy>
+SessionClock::Clock::time_point BasicOrderBook<Policy>::GetTime() const
+{
+    std::scoped_lock ordersLock{ordersMutex_};
+    return clock_.Now();
+}
+
+template <MatchingPolicy Policy>
+void BasicOrderBook<Policy>::LinkOwner(OrderEntry &entry)
+{
+    const auto ownerId = entry.order_->GetOwnerId();
+    if (ownerId == Constants::NoOwner)
+        return;
+
+    // newest order goes at the front, the order within an owner's list does not matter
+    auto &owner = owners_[ownerId];
+    entry.previousOwned_ = nullptr;
+    entry.nextOwned_ = owner.first_;
+    if (owner.first_ != nullptr)
+        owner.first_->previousOwned_ = &entry;
+    owner.first_ = &entry;
+    owner.count_++;
+}
+
+template <MatchingPolicy Policy>
+void BasicOrderBook<Policy>::UnlinkOwner(OrderEntry &entry)
+{
+    const auto ownerId = entry.order_->GetOwnerId();
+    if (ownerId == Constants::NoOwner)
         return;
 
-    // get the order from the map, and use the iterator to remove the order double linked list from the bid/ask map at the order price level
-    const auto [order, orderIterator] = orders_[orderId];
+    auto owner = owners_.find(ownerId);
+    if (entry.previousOwned_ != nullptr)
+        entry.previousOwned_->nextOwned_ = entry.nextOwned_;
+    else
+        owner->second.first_ = entry.nextOwned_;
+    if (entry.nextOwned_ != nullptr)
+        entry.nextOwned_->previousOwned_ = entry.previousOwned_;
+
+    if (--owner->second.count_ == 0)
+        owners_.erase(owner);
+}
+
+template <MatchingPolicy Policy>
+void BasicOrderBook<Policy>::UnlinkOrderEntry(OrderEntry &entry)
+{
+    UnlinkOwner(entry);
+    if (entry.pegGroup_ != nullptr)
+        UnlinkPeg(entry);
+    if (entry.handleIndex_ != NoHandle)
+        ReleaseHandle(entry.handleIndex_);
+}
+
+template <MatchingPolicy Policy>
+void BasicOrderBook<Policy>::EraseOrderEntry(OrderId orderId)
+{
+    auto entry = orders_.find(orderId);
+    UnlinkOrderEntry(entry->second);
+    orders_.erase(entry);
+}
+
+template <MatchingPolicy Policy>
+void BasicOrderBook<Policy>::EraseOrderEntry(OrderEntry &entry)
+{
+    // everything but orders_ is reached through the entry. the map is erased by key, one hash and one walk of the bucket,
+    // which is what erasing through an iterator costs as well since the node before it in the bucket has to be found
+    const auto orderId = entry.order_->GetOrderId();
+    UnlinkOrderEntry(entry);
     orders_.erase(orderId);
+}
+
+template <MatchingPolicy Policy>
+bool BasicOrderBook<Policy>::IsPassivePeg(const PegKey &key)
+{
+    if (key.side_ == Side::Buy)
+        return key.reference_ != PegReference::BestAsk && key.offset_ <= 0;
+    return key.reference_ != PegReference::BestBid && key.offset_ >= 0;
+}
+
+template <MatchingPolicy Policy>
+std::optional<Price> BasicOrderBook<Policy>::GetPegPrice(const PegKey &key, std::optional<Price> bestBid, std::optional<Price> bestAsk)
+{
+    switch (key.reference_)
+    {
+    case PegReference::BestBid:
+        if (!bestBid)
+            return std::nullopt;
+        return *bestBid + key.offset_;
+    case PegReference::BestAsk:
+        if (!bestAsk)
+            return std::nullopt;
+        return *bestAsk + key.offset_;
+    case PegReference::Midpoint:
+    default:
+    {
+        if (!bestBid || !bestAsk)
+            return std::nullopt;
+        // rounded away from the other side, down for bids and up for asks
+        const std::int64_t sum = static_cast<std::int64_t>(*bestBid) + *bestAsk;
+        const std::int64_t lower = (sum - (sum & 1)) / 2;
+        const std::int64_t midpoint = key.side_ == Side::Buy ? lower : lower + (sum & 1);
+        return static_cast<Price>(midpoint + key.offset_);
+    }
+    }
+}
 
-    // remove the order from the bid map
-    if (order->GetSide() == Side::Buy)
+template <MatchingPolicy Policy>
+template <typename Levels>
+std::optional<Price> BasicOrderBook<Policy>::GetUnpeggedBest(const Levels &levels)
+{
+    // pegs never set their own reference, levels holding only pegs are skipped
+    for (const auto &[price, level] : levels)
     {
-        auto price = order->GetPrice();
-        auto &orders = bids_.at(price);
-        orders.erase(orderIterator);
-        if (orders.empty())
+        if (level.orders_.size() > level.peggedCount_)
+            return price;
+    }
+    return std::nullopt;
+}
+
+template <MatchingPolicy Policy>
+void BasicOrderBook<Policy>::LinkPeg(OrderEntry &entry, PegGroup &group)
+{
+    // newest order goes at the back, the group keeps time priority when it moves
+    entry.pegGroup_ = &group;
+    entry.previousPegged_ = group.last_;
+    entry.nextPegged_ = nullptr;
+    if (group.last_ != nullptr)
+        group.last_->nextPegged_ = &entry;
+    else
+        group.first_ = &entry;
+    group.last_ = &entry;
+    group.count_++;
+    entry.level_->peggedCount_++;
+}
+
+template <MatchingPolicy Policy>
+void BasicOrderBook<Policy>::UnlinkPeg(OrderEntry &entry)
+{
+    auto &group = *entry.pegGroup_;
+    if (entry.previousPegged_ != nullptr)
+        entry.previousPegged_->nextPegged_ = entry.nextPegged_;
+    else
+        group.first_ = entry.nextPegged_;
+    if (entry.nextPegged_ != nullptr)
+        entry.nextPegged_->previousPegged_ = entry.previousPegged_;
+    else
+        group.last_ = entry.previousPegged_;
+
+    // an empty group is dropped on the next repricing, matching may still be walking the groups
+    group.count_--;
+    entry.level_->peggedCount_--;
+    entry.pegGroup_ = nullptr;
+}
+
+template <MatchingPolicy Policy>
+void BasicOrderBook<Policy>::MovePegGroup(Side side, PegGroup &group, Price price)
+{
+    // the new level is looked up once for the whole group, then every order's list node is spliced across in time priority,
+    // behind the orders already resting there. nothing is allocated or looked up per order
+    auto &level = side == Side::Buy ? bids_[price] : asks_[price];
+    for (auto *entry = group.first_; entry != nullptr; entry = entry->nextPegged_)
+    {
+        auto &order = *entry->order_;
+        auto &previousLevel = *entry->level_;
+
+        OnOrderRemoved(entry->order_);
+        previousLevel.queue_.Remove(order.GetQueueSequence(), order.GetRemainingQuantity(), true);
+        previousLevel.peggedCount_--;
+        level.orders_.splice(level.orders_.end(), previousLevel.orders_, entry->location_);
+        if (previousLevel.orders_.empty())
         {
-            bids_.erase(price);
+            if (side == Side::Buy)
+                bids_.erase(order.GetPrice());
+            else
+                asks_.erase(order.GetPrice());
         }
+
+        order.Reprice(price);
+        entry->level_ = &level;
+        level.peggedCount_++;
+        EnqueueOrder(level, order, *entry);
+        OnOrderAdded(entry->order_);
     }
-    // remove the order from the ask map
-    else
+    group.price_ = price;
+}
+
+template <MatchingPolicy Policy>
+void BasicOrderBook<Policy>::RepricePegs(Trades &trades)
+{
+    if (pegGroups_.empty())
+        return;
+
+    // moving pegs never changes the reference prices, so one pass over the groups is enough. only the groups following a
+    // best price that moved are visited, none at all when neither did
+    const auto bestBid = GetUnpeggedBest(bids_);
+    const auto bestAsk = GetUnpeggedBest(asks_);
+    const bool bidMoved = bestBid != pegBestBid_;
+    const bool askMoved = bestAsk != pegBestAsk_;
+    if (!bidMoved && !askMoved)
+        return;
+    pegBestBid_ = bestBid;
+    pegBestAsk_ = bestAsk;
+
+    std::optional<Side> aggressorSide;
+    if (bidMoved)
+        RepricePegGroups(PegReference::BestBid, bestBid, bestAsk, aggressorSide);
+    if (askMoved)
+        RepricePegGroups(PegReference::BestAsk, bestBid, bestAsk, aggressorSide);
+    RepricePegGroups(PegReference::Midpoint, bestBid, bestAsk, aggressorSide);
+
+    // only midpoint pegs can cross, and only each other. the rest of the book is never handed to the matching loop
+    if (!aggressorSide)
+        return;
+
+    auto matched = MatchOrder(*aggressorSide);
+    trades.insert(trades.end(), matched.begin(), matched.end());
+}
+
+template <MatchingPolicy Policy>
+void BasicOrderBook<Policy>::RepricePegGroups(PegReference reference, std::optional<Price> bestBid, std::optional<Price> bestAsk, std::optional<Side> &aggressorSide)
+{
+    const PegKey firstKey{reference, Side::Buy, std::numeric_limits<Price>::lowest()};
+    for (auto group = pegGroups_.lower_bound(firstKey); group != pegGroups_.end() && group->first.reference_ == reference;)
     {
-        auto price = order->GetPrice();
-        auto &orders = asks_.at(price);
-        orders.erase(orderIterator);
-        if (orders.empty())
+        auto &[key, pegGroup] = *group;
+        if (pegGroup.count_ == 0)
         {
-            asks_.erase(price);
+            group = pegGroups_.erase(group);
+            continue;
         }
+
+        // a group whose reference price is gone stays where it is
+        const auto price = GetPegPrice(key, bestBid, bestAsk);
+        if (price && *price != pegGroup.price_)
+        {
+            MovePegGroup(key.side_, pegGroup, *price);
+            if (CanMatch(key.side_, *price))
+                aggressorSide = key.side_;
+        }
+        ++group;
+    }
+}
+
+template <MatchingPolicy Policy>
+void BasicOrderBook<Policy>::PrependPegTrades(Trades &trades)
+{
+    if (pegTrades_.empty())
+        return;
+
+    trades.insert(trades.begin(), pegTrades_.begin(), pegTrades_.end());
+    pegTrades_.clear();
+}
+
+template <MatchingPolicy Policy>
+Trades BasicOrderBook<Policy>::TakePegTrades()
+{
+    std::scoped_lock ordersLock{ordersMutex_};
+    return std::exchange(pegTrades_, Trades{});
+}
+
+template <MatchingPolicy Policy>
+OrderHandle BasicOrderBook<Policy>::AcquireHandle(OrderEntry &entry)
+{
+    if (freeHandleSlot_ == NoHandle)
+    {
+        freeHandleSlot_ = static_cast<std::uint32_t>(handleSlots_.size());
+        handleSlots_.emplace_back();
+    }
+
+    const auto index = freeHandleSlot_;
+    auto &slot = handleSlots_[index];
+    freeHandleSlot_ = slot.nextFree_;
+
+    slot.entry_ = &entry;
+    entry.handleIndex_ = index;
+    return OrderHandle{index, slot.generation_};
+}
+
+template <MatchingPolicy Policy>
+void BasicOrderBook<Policy>::ReleaseHandle(std::uint32_t index)
+{
+    auto &slot = handleSlots_[index];
+    // a new generation invalidates every handle given out for this slot, zero is skipped because it marks an empty handle
+    if (++slot.generation_ == 0)
+        slot.generation_ = 1;
+    slot.entry_ = nullptr;
+    slot.nextFree_ = freeHandleSlot_;
+    freeHandleSlot_ = index;
+}
+
+template <MatchingPolicy Policy>
+typename BasicOrderBook<Policy>::OrderEntry *BasicOrderBook<Policy>::ResolveHandle(OrderHandle handle) const
+{
+    if (!handle.IsValid() || handle.index_ >= handleSlots_.size())
+        return nullptr;
+
+    const auto &slot = handleSlots_[handle.index_];
+    return slot.generation_ == handle.generation_ ? slot.entry_ : nullptr;
+}
+
+template <MatchingPolicy Policy>
+void BasicOrderBook<Policy>::CancelOrderInternal(OrderId orderId)
+{
+    auto entry = orders_.find(orderId);
+    if (entry == orders_.end())
+        return;
+
+    CancelOrderEntry(entry->second);
+}
+
+template <MatchingPolicy Policy>
+void BasicOrderBook<Policy>::CancelOrderEntry(OrderEntry &entry)
+{
+    // keep the order alive, erasing the entry drops the book's reference to it
+    const auto order = entry.order_;
+
+    // the entry knows its price level, so the order comes straight out of the level list without a bid/ask map lookup
+    auto &level = *entry.level_;
+    level.queue_.Remove(order->GetQueueSequence(), order->GetRemainingQuantity(), true);
+    level.orders_.erase(entry.location_);
+
+    // before the level goes, a pegged entry still counts itself out of it
+    EraseOrderEntry(entry);
+
+    if (level.orders_.empty())
+    {
+        if (order->GetSide() == Side::Buy)
+            bids_.erase(order->GetPrice());
+        else
+            asks_.erase(order->GetPrice());
     }
 
     OnOrderRemoved(order);
 }
 
-void OrderBook::OnOrderAdded(OrderPointer order)
+template <MatchingPolicy Policy>
+void BasicOrderBook<Policy>::OnOrderAdded(OrderPointer order)
 {
+    riskGate_.OnOrderAdded(*order);
     UpdateLevelData(order->GetSide(), order->GetPrice(), order->GetRemainingQuantity(), LevelData::Action::Add);
 };
 
-void OrderBook::OnOrderRemoved(OrderPointer order)
+template <MatchingPolicy Policy>
+void BasicOrderBook<Policy>::OnOrderRemoved(OrderPointer order)
 {
+    riskGate_.OnOrderRemoved(*order);
     UpdateLevelData(order->GetSide(), order->GetPrice(), order->GetRemainingQuantity(), LevelData::Action::Remove);
 };
 
-void OrderBook::OnOrderMatched(Side side, Price price, Quantity quantity, bool isFullyFilled)
+template <MatchingPolicy Policy>
+void BasicOrderBook<Policy>::OnOrderMatched(Side side, Price price, Quantity quantity, bool isFullyFilled)
 {
     UpdateLevelData(side, price, quantity, isFullyFilled ? LevelData::Action::Remove : LevelData::Action::Match);
 };
 
-void OrderBook::UpdateLevelData(Side side, Price price, Quantity quantity, LevelData::Action action)
+template <MatchingPolicy Policy>
+void BasicOrderBook<Policy>::UpdateLevelData(Side side, Price price, Quantity quantity, LevelData::Action action)
 {
     auto &levelData = data_[price];
 
@@ -144,13 +548,19 @@ void OrderBook::UpdateLevelData(Side side, Price price, Quantity quantity, Level
             levelData.askQuantity_ -= quantity;
     }
 
+    if (marketDataPublisher_ != nullptr)
+    {
+        marketDataPublisher_->PublishLevel(side, price, side == Side::Buy ? levelData.bidQuantity_ : levelData.askQuantity_);
+    }
+
     if (levelData.count_ == 0)
     {
         data_.erase(price);
     }
 }
 
-bool OrderBook::CanMatch(Side side, Price price) const
+template <MatchingPolicy Policy>
+bool BasicOrderBook<Policy>::CanMatch(Side side, Price price) const
 {
     if (side == Side::Buy)
     {
@@ -173,10 +583,150 @@ bool OrderBook::CanMatch(Side side, Price price) const
     }
 }
 
-Trades OrderBook::MatchOrder()
+template <MatchingPolicy Policy>
+void BasicOrderBook<Policy>::FillOrders(PriceLevel &bidLevel, Order &bid, PriceLevel &askLevel, Order &ask, Price bidPrice, Price askPrice, Quantity quantity, Side aggressorSide, Trades &trades, TradeAnalytics::Clock::time_point &matchTime)
 {
+    bid.Fill(quantity);
+    ask.Fill(quantity);
+    bidLevel.queue_.Remove(bid.GetQueueSequence(), quantity, bid.IsFilled());
+    askLevel.queue_.Remove(ask.GetQueueSequence(), quantity, ask.IsFilled());
+    riskGate_.OnOrderFilled(bid, quantity);
+    riskGate_.OnOrderFilled(ask, quantity);
+
+    // create the trade, every order in the level rests at the level price so it does not need to be read from the order
+    const Trade trade{TradeInfo{bid.GetOrderId(), bidPrice, quantity}, TradeInfo{ask.GetOrderId(), askPrice, quantity}};
+    if (executionReport_ != nullptr)
+    {
+        if (aggressorSide == Side::Buy)
+            executionReport_->OnFill(bid, ask.GetOrderId(), askPrice, quantity);
+        else
+            executionReport_->OnFill(ask, bid.GetOrderId(), bidPrice, quantity);
+    }
+    else
+    {
+        AllocationScope allocationScope{AllocationSite::MatchTrades};
+        trades.push_back(trade);
+    }
+
+    // read the clock once per match, not once per fill
+    if (matchTime == TradeAnalytics::Clock::time_point{})
+        matchTime = clock_.Now();
+    tradeAnalytics_.OnTrade(aggressorSide == Side::Buy ? askPrice : bidPrice, quantity, aggressorSide, matchTime);
+
+    if (marketDataPublisher_ != nullptr)
+        marketDataPublisher_->PublishTrade(trade);
+
+    // call for bid and ask order
+    OnOrderMatched(Side::Buy, bidPrice, quantity, bid.IsFilled());
+    OnOrderMatched(Side::Sell, askPrice, quantity, ask.IsFilled());
+}
+
+template <MatchingPolicy Policy>
+bool BasicOrderBook<Policy>::MatchProRata(Side aggressorSide, Price bidPrice, PriceLevel &bidLevel, Price askPrice, PriceLevel &askLevel, Trades &trades, TradeAnalytics::Clock::time_point &matchTime)
+{
+    // the incoming order is alone at the front of its level, the book was not crossed before it arrived
+    auto &incoming = aggressorSide == Side::Buy ? bidLevel.orders_ : askLevel.orders_;
+    auto &resting = aggressorSide == Side::Buy ? askLevel.orders_ : bidLevel.orders_;
+    auto &aggressor = *incoming.front();
+
+    const auto fill = [&](Order &restingOrder, Quantity quantity)
+    {
+        if (aggressorSide == Side::Buy)
+            FillOrders(bidLevel, aggressor, askLevel, restingOrder, bidPrice, askPrice, quantity, aggressorSide, trades, matchTime);
+        else
+            FillOrders(bidLevel, restingOrder, askLevel, aggressor, bidPrice, askPrice, quantity, aggressorSide, trades, matchTime);
+    };
+
+    // top order priority, the oldest resting order fills first and only what is left is shared out
+    if constexpr (Policy::TopOrderPriority)
+    {
+        auto &top = *resting.front();
+        const Quantity quantity = std::min(aggressor.GetRemainingQuantity(), top.GetRemainingQuantity());
+        fill(top, quantity);
+
+        if (top.IsFilled())
+        {
+            EraseOrderEntry(top.GetOrderId());
+            resting.pop_front();
+        }
+
+        if (aggressor.IsFilled() || resting.empty())
+        {
+            if (aggressor.IsFilled())
+            {
+                EraseOrderEntry(aggressor.GetOrderId());
+                incoming.pop_front();
+            }
+            return true;
+        }
+    }
+
+    proRataQuantities_.clear();
+    std::uint64_t levelQuantity = 0;
+    for (const auto &order : resting)
+    {
+        proRataQuantities_.push_back(order->GetRemainingQuantity());
+        levelQuantity += order->GetRemainingQuantity();
+    }
+
+    // an order that takes the whole level fills every resting order in full, in one pass so the level is not shared out again
+    // after each fill
+    const Quantity quantity = aggressor.GetRemainingQuantity();
+    if (quantity >= levelQuantity)
+    {
+        while (!resting.empty())
+        {
+            auto &restingOrder = *resting.front();
+            fill(restingOrder, restingOrder.GetRemainingQuantity());
+            EraseOrderEntry(restingOrder.GetOrderId());
+            resting.pop_front();
+        }
+
+        if (aggressor.IsFilled())
+        {
+            EraseOrderEntry(aggressor.GetOrderId());
+            incoming.pop_front();
+        }
+        return true;
+    }
+
+    proRataAllocations_.resize(proRataQuantities_.size());
+    AllocateProRata(proRataQuantities_.data(), proRataAllocations_.data(), proRataQuantities_.size(), levelQuantity, quantity);
+
+    // fill in time priority, the allocations add up to the incoming quantity so the incoming order always fills here
+    std::size_t index = 0;
+    for (auto order = resting.begin(); order != resting.end(); index++)
+    {
+        auto &restingOrder = **order;
+        const Quantity allocation = proRataAllocations_[index];
+        if (allocation == 0)
+        {
+            ++order;
+            continue;
+        }
+
+        fill(restingOrder, allocation);
+
+        if (restingOrder.IsFilled())
+        {
+            EraseOrderEntry(restingOrder.GetOrderId());
+            order = resting.erase(order);
+        }
+        else
+            ++order;
+    }
+
+    EraseOrderEntry(aggressor.GetOrderId());
+    incoming.pop_front();
+    return true;
+}
+
+template <MatchingPolicy Policy>
+Trades BasicOrderBook<Policy>::MatchOrder(Side aggressorSide)
+{
+    // no up front reserve, an order that rests without trading should not allocate at all
     Trades trades;
-    trades.reserve(orders_.size());
+    TradeAnalytics::Clock::time_point matchTime;
 
     while (true)
     {
@@ -185,8 +735,10 @@ Trades OrderBook::MatchOrder()
             break;
 
         // best bid and best ask orders
-        auto &[bidPrice, bids] = *bids_.begin();
-        auto &[askPrice, asks] = *asks_.begin();
+        auto &[bidPrice, bidLevel] = *bids_.begin();
+        auto &[askPrice, askLevel] = *asks_.begin();
+        auto &bids = bidLevel.orders_;
+        auto &asks = askLevel.orders_;
 
         if (bidPrice < askPrice)
             break;
@@ -194,35 +746,38 @@ Trades OrderBook::MatchOrder()
         // match orders to create trades
         while (!bids.empty() && !asks.empty())
         {
+            // a pro rata policy shares the incoming order out across the whole level when it cannot sweep it
+            if constexpr (Policy::ProRata)
+            {
+                if (MatchProRata(aggressorSide, bidPrice, bidLevel, askPrice, askLevel, trades, matchTime))
+                    continue;
+            }
+
             // get the orders based on when submitted, lowest to highest
-            auto bid = bids.front();
-            auto ask = asks.front();
+            // taken by reference so matching does not pay for a shared_ptr reference count round trip per order
+            auto &bid = *bids.front();
+            auto &ask = *asks.front();
 
             // match these orders for max amount of quantity
-            Quantity quantity = std::min(bid->GetRemainingQuantity(), ask->GetRemainingQuantity());
+            Quantity quantity = std::min(bid.GetRemainingQuantity(), ask.GetRemainingQuantity());
 
-            bid->Fill(quantity);
-            ask->Fill(quantity);
+            FillOrders(bidLevel, bid, askLevel, ask, bidPrice, askPrice, quantity, aggressorSide, trades, matchTime);
 
-            // remove the orders if they are completely filled
-            if (bid->IsFilled())
+            const bool bidFilled = bid.IsFilled();
+            const bool askFilled = ask.IsFilled();
+
+            // remove the orders if they are completely filled, this releases the order so it has to happen last
+            if (bidFilled)
             {
+                EraseOrderEntry(bid.GetOrderId());
                 bids.pop_front();
-                orders_.erase(bid->GetOrderId());
             };
 
-            if (ask->IsFilled())
+            if (askFilled)
             {
+                EraseOrderEntry(ask.GetOrderId());
                 asks.pop_front();
-                orders_.erase(ask->GetOrderId());
             };
-
-            // create the trade
-            trades.push_back(Trade{TradeInfo{bid->GetOrderId(), bid->GetPrice(), quantity}, TradeInfo{ask->GetOrderId(), ask->GetPrice(), quantity}});
-
-            // call for bid and ask order
-            OnOrderMatched(Side::Buy, bid->GetPrice(), quantity, bid->IsFilled());
-            OnOrderMatched(Side::Sell, ask->GetPrice(), quantity, ask->IsFilled());
         }
 
         // Remove the price level of a bid/ask if all the orders in this price level were matched, from the bids and asks map
@@ -245,27 +800,27 @@ Trades OrderBook::MatchOrder()
             data_.erase(askPrice);
         }
 
-        // Cancel any bid/ask orders which were fill and kill type
+        // Cancel any bid/ask orders which were fill and kill type, the orders mutex is already held by the caller
         if (!bids_.empty())
         {
 
-            auto &[_, bids] = *bids_.begin();
-            auto &order = *bids.front();
+            auto &[_, bidLevel] = *bids_.begin();
+            auto &order = *bidLevel.orders_.front();
 
             if (order.GetOrderType() == OrderType::FillAndKill)
             {
-                CancelOrder(order.GetOrderId());
+                CancelOrderInternal(order.GetOrderId());
             }
         }
 
         if (!asks_.empty())
         {
-            auto &[_, asks] = *asks_.begin();
-            auto &order = *asks.front();
+            auto &[_, askLevel] = *asks_.begin();
+            auto &order = *askLevel.orders_.front();
 
             if (order.GetOrderType() == OrderType::FillAndKill)
             {
-                CancelOrder(order.GetOrderId());
+                CancelOrderInternal(order.GetOrderId());
             }
         }
     }
@@ -273,7 +828,8 @@ Trades OrderBook::MatchOrder()
     return trades;
 }
 
-bool OrderBook::CanFullyFill(Side side, Price price, Quantity quantity) const
+template <MatchingPolicy Policy>
+bool BasicOrderBook<Policy>::CanFullyFill(Side side, Price price, Quantity quantity) const
 {
     if (!CanMatch(side, price))
         return false;
@@ -317,14 +873,110 @@ bool OrderBook::CanFullyFill(Side side, Price price, Quantity quantity) const
     return false;
 };
 
-Trades OrderBook::AddOrder(OrderPointer order)
+template <MatchingPolicy Policy>
+std::optional<Price> BasicOrderBook<Policy>::GetRiskReferencePrice(Side side) const
+{
+    // the last trade when there has been one this session, otherwise the best price the order would trade against, then its own side
+    if (tradeAnalytics_.GetSession().tradeCount_ != 0)
+        return tradeAnalytics_.GetSession().last_;
+
+    const bool hasBids = !bids_.empty();
+    const bool hasAsks = !asks_.empty();
+    if (side == Side::Buy ? hasAsks : hasBids)
+        return side == Side::Buy ? asks_.begin()->first : bids_.begin()->first;
+    if (side == Side::Buy ? hasBids : hasAsks)
+        return side == Side::Buy ? bids_.begin()->first : asks_.begin()->first;
+
+    return std::nullopt;
+}
+
+template <MatchingPolicy Policy>
+void BasicOrderBook<Policy>::SetRiskLimits(const RiskLimits &limits)
+{
+    std::scoped_lock ordersLock{ordersMutex_};
+    riskGate_.SetLimits(limits);
+}
+
+template <MatchingPolicy Policy>
+void BasicOrderBook<Policy>::SetOwnerRiskLimits(OwnerId ownerId, const OwnerRiskLimits &limits)
+{
+    std::scoped_lock ordersLock{ordersMutex_};
+    riskGate_.SetOwnerLimits(ownerId, limits);
+}
+
+template <MatchingPolicy Policy>
+RiskRejections BasicOrderBook<Policy>::GetRiskRejections() const
+{
+    std::scoped_lock ordersLock{ordersMutex_};
+    return riskGate_.GetRejections();
+}
+
+template <MatchingPolicy Policy>
+void BasicOrderBook<Policy>::SetMarketDataPublisher(MarketDataPublisher *publisher)
+{
+    std::scoped_lock ordersLock{ordersMutex_};
+    marketDataPublisher_ = publisher;
+}
+
+template <MatchingPolicy Policy>
+Trades BasicOrderBook<Policy>::AddOrder(OrderPointer order)
 {
+    AllocationScope allocationScope{AllocationSite::AddOrder};
+    std::scoped_lock ordersLock{ordersMutex_};
+    OrderStatus status;
+    return AddOrderInternal(order, nullptr, status);
+}
 
+template <MatchingPolicy Policy>
+Trades BasicOrderBook<Policy>::AddOrder(OrderPointer order, OrderStatus &status)
+{
+    AllocationScope allocationScope{AllocationSite::AddOrder};
     std::scoped_lock ordersLock{ordersMutex_};
+    return AddOrderInternal(order, nullptr, status);
+}
+
+template <MatchingPolicy Policy>
+Trades BasicOrderBook<Policy>::AddOrder(OrderPointer order, OrderHandle &handle)
+{
+    AllocationScope allocationScope{AllocationSite::AddOrder};
+    std::scoped_lock ordersLock{ordersMutex_};
+    OrderStatus status;
+    return AddOrderInternal(order, &handle, status);
+}
+
+template <MatchingPolicy Policy>
+void BasicOrderBook<Policy>::AddOrder(OrderPointer order, ExecutionReport &report)
+{
+    AllocationScope allocationScope{AllocationSite::AddOrder};
+    std::scoped_lock ordersLock{ordersMutex_};
+
+    OrderStatus status;
+    executionReport_ = &report;
+    AddOrderInternal(order, nullptr, status);
+    executionReport_ = nullptr;
+
+    if (!status.IsAccepted())
+        report.RejectOrder(order->GetOrderId(), order->GetSide(), order->GetRemainingQuantity(), status);
+}
+
+template <MatchingPolicy Policy>
+Trades BasicOrderBook<Policy>::AddOrderInternal(OrderPointer order, OrderHandle *handle, OrderStatus &status)
+{
+    if (handle != nullptr)
+        *handle = OrderHandle{};
+    status = OrderStatus{};
 
     // order already exists
     if (orders_.contains(order->GetOrderId()))
     {
+        status.reason_ = RejectReason::DuplicateOrderId;
+        return {};
+    }
+
+    // a zero lot order would rest and then trade for nothing
+    if (order->GetRemainingQuantity() == 0)
+    {
+        status.reason_ = RejectReason::InvalidOrder;
         return {};
     }
 
@@ -343,49 +995,170 @@ Trades OrderBook::AddOrder(OrderPointer order)
         }
         else
         {
+            status.reason_ = RejectReason::NoLiquidity;
             return {};
         }
     }
 
+    if (const auto check = riskGate_.Check(*order, GetRiskReferencePrice(order->GetSide())); check != RiskCheck::Passed)
+    {
+        status = OrderStatus{RejectReason::RiskCheck, check};
+        return {};
+    }
+
     // if order is of type fill and kill and it cant match with any other orders, then discard order right there and then
     if (order->GetOrderType() == OrderType::FillAndKill && !CanMatch(order->GetSide(), order->GetPrice()))
     {
+        status.reason_ = RejectReason::CannotMatch;
         return {};
     }
 
     // if fill or kill order but cant fully fill, then dont add the order in the orderbook
     if (order->GetOrderType() == OrderType::FillOrKill && !CanFullyFill(order->GetSide(), order->GetPrice(), order->GetIntialQuantity()))
     {
+        status.reason_ = RejectReason::CannotFullyFill;
         return {};
     }
 
-    OrderPointers::iterator iterator;
+    if (executionReport_ != nullptr)
+        executionReport_->BeginOrder(*order);
+
+    auto &entry = InsertOrder(order);
 
+    OrderHandle addedHandle;
+    if (handle != nullptr)
+        addedHandle = AcquireHandle(entry);
+
+    auto trades = MatchOrder(order->GetSide());
+    if (executionReport_ != nullptr)
+        executionReport_->EndOrder(*order, orders_.contains(order->GetOrderId()));
+
+    RepricePegs(trades);
+    if (executionReport_ == nullptr)
+        PrependPegTrades(trades);
+
+    // the handle is only worth returning if the order is still resting after matching
+    if (handle != nullptr && ResolveHandle(addedHandle) != nullptr)
+        *handle = addedHandle;
+
+    return trades;
+}
+
+template <MatchingPolicy Policy>
+Trades BasicOrderBook<Policy>::AddPeggedOrder(OrderPointer order, PegReference reference, Price offset)
+{
+    AllocationScope allocationScope{AllocationSite::AddOrder};
+    std::scoped_lock ordersLock{ordersMutex_};
+
+    const PegKey key{reference, order->GetSide(), offset};
+    if (orders_.contains(order->GetOrderId()) || order->GetRemainingQuantity() == 0 || !IsPassivePeg(key))
+        return {};
+    if (order->GetOrderType() != OrderType::GoodTillCancel && order->GetOrderType() != OrderType::GoodForDay)
+        return {};
+
+    // every group is at its reference price after each operation, so a new peg joins its group where the group already rests.
+    // the same holds when there were no groups to reprice, the best prices are taken as the ones the groups were priced from
+    pegBestBid_ = GetUnpeggedBest(bids_);
+    pegBestAsk_ = GetUnpeggedBest(asks_);
+    const auto price = GetPegPrice(key, pegBestBid_, pegBestAsk_);
+    if (!price)
+        return {};
+    order->Reprice(*price);
+
+    if (riskGate_.Check(*order, GetRiskReferencePrice(order->GetSide())) != RiskCheck::Passed)
+        return {};
+
+    auto &entry = InsertOrder(order);
+    auto &group = pegGroups_[key];
+    group.price_ = *price;
+    LinkPeg(entry, group);
+
+    auto trades = MatchOrder(order->GetSide());
+    RepricePegs(trades);
+    PrependPegTrades(trades);
+    return trades;
+}
+
+template <MatchingPolicy Policy>
+typename BasicOrderBook<Policy>::OrderEntry &BasicOrderBook<Policy>::InsertOrder(OrderPointer order)
+{
     // add the order to the corresponding dict
-    if (order->GetSide() == Side::Buy)
+    auto &level = order->GetSide() == Side::Buy ? bids_[order->GetPrice()] : asks_[order->GetPrice()];
+    level.orders_.push_back(order);
+
+    // add the order to the cumalative order list
+    auto [entry, _] = orders_.insert({order->GetOrderId(), OrderEntry{order, std::prev(level.orders_.end()), &level}});
+    EnqueueOrder(level, *order, entry->second);
+    LinkOwner(entry->second);
+
+    OnOrderAdded(order);
+    return entry->second;
+}
+
+template <MatchingPolicy Policy>
+void BasicOrderBook<Policy>::ResizeOrder(OrderEntry &entry, Quantity quantity)
+{
+    auto &order = *entry.order_;
+    auto &level = *entry.level_;
+    const Quantity previousQuantity = order.GetRemainingQuantity();
+
+    // taken out of the level data and the risk state at the old size and put back at the new one
+    OnOrderRemoved(entry.order_);
+    if (quantity < previousQuantity)
     {
-        auto &orders = bids_[order->GetPrice()];
-        orders.push_back(order);
-        iterator = std::next(orders.begin(), orders.size() - 1);
+        // a smaller order keeps its place in the queue, only the quantity it gave up leaves the level
+        level.queue_.Remove(order.GetQueueSequence(), previousQuantity - quantity, false);
+        order.Resize(quantity);
     }
     else
     {
-        auto &orders = asks_[order->GetPrice()];
-        orders.push_back(order);
-        iterator = std::next(orders.begin(), orders.size() - 1);
-    };
+        // a larger order goes to the back of the level, the list node is moved rather than reallocated
+        level.queue_.Remove(order.GetQueueSequence(), previousQuantity, true);
+        level.orders_.splice(level.orders_.end(), level.orders_, entry.location_);
+        order.Resize(quantity);
+        EnqueueOrder(level, order, entry);
+    }
+    OnOrderAdded(entry.order_);
+}
 
-    // add the order to the cumalative order list
-    orders_.insert({order->GetOrderId(), OrderEntry{order, iterator}});
+template <MatchingPolicy Policy>
+void BasicOrderBook<Policy>::EnqueueOrder(PriceLevel &level, Order &order, OrderEntry &entry)
+{
+    // out of sequence numbers, renumber the orders already resting in time priority and make room for twice as many.
+    // a level that holds n orders has taken at least n new orders since it was last renumbered, so this is amortized constant time
+    if (level.queue_.IsFull())
+    {
+        level.queue_.Reset(std::max(MinQueueCapacity, std::bit_ceil(2 * level.orders_.size())));
+        for (auto resting = level.orders_.begin(); resting != entry.location_; ++resting)
+        {
+            auto &restingOrder = **resting;
+            auto &restingEntry = orders_.find(restingOrder.GetOrderId())->second;
+            restingOrder.SetQueueSequence(level.queue_.Enqueue(restingOrder.GetRemainingQuantity(), restingEntry.queueOffset_));
+        }
+    }
 
-    OnOrderAdded(order);
+    order.SetQueueSequence(level.queue_.Enqueue(order.GetRemainingQuantity(), entry.queueOffset_));
+}
+
+template <MatchingPolicy Policy>
+std::optional<QueuePosition> BasicOrderBook<Policy>::GetQueuePosition(OrderId orderId) const
+{
+    std::scoped_lock ordersLock{ordersMutex_};
 
-    return MatchOrder();
+    auto entry = orders_.find(orderId);
+    if (entry == orders_.end())
+        return std::nullopt;
+
+    const auto &orderEntry = entry->second;
+    return orderEntry.level_->queue_.GetPosition(orderEntry.order_->GetQueueSequence(), orderEntry.queueOffset_);
 }
 
-Trades OrderBook::ModifyOrder(OrderModify orderModify)
+template <MatchingPolicy Policy>
+Trades BasicOrderBook<Policy>::ModifyOrder(OrderModify orderModify)
 {
+    AllocationScope allocationScope{AllocationSite::ModifyOrder};
     OrderType orderType;
+    OwnerId ownerId;
     {
         std::scoped_lock ordersLock{ordersMutex_};
 
@@ -395,50 +1168,341 @@ Trades OrderBook::ModifyOrder(OrderModify orderModify)
             return {};
         }
 
-        // get the old order, and save the order type to add to the new modified order
-        const auto &[order, iterator] = orders_.at(orderModify.GetOrderId());
+        // get the old order, and save the order type and owner to add to the new modified order
+        const auto &order = orders_.at(orderModify.GetOrderId()).order_;
         orderType = order->GetOrderType();
+        ownerId = order->GetOwnerId();
     }
 
     CancelOrder(orderModify.GetOrderId());
-    return AddOrder(orderModify.ToOrderPointer(orderType));
+    return AddOrder(orderModify.ToOrderPointer(orderType, ownerId, &orderResource_));
+}
+
+template <MatchingPolicy Policy>
+Trades BasicOrderBook<Policy>::ModifyOrder(OrderModify orderModify, OrderStatus &status)
+{
+    AllocationScope allocationScope{AllocationSite::ModifyOrder};
+    std::scoped_lock ordersLock{ordersMutex_};
+
+    auto entry = orders_.find(orderModify.GetOrderId());
+    if (entry == orders_.end())
+    {
+        status = OrderStatus{RejectReason::UnknownOrder};
+        return {};
+    }
+
+    const auto orderType = entry->second.order_->GetOrderType();
+    const auto ownerId = entry->second.order_->GetOwnerId();
+
+    // the cancel and the add happen under one lock, a rejected replacement leaves the order cancelled
+    CancelOrderEntry(entry->second);
+    return AddOrderInternal(orderModify.ToOrderPointer(orderType, ownerId, &orderResource_), nullptr, status);
+}
+
+template <MatchingPolicy Policy>
+void BasicOrderBook<Policy>::ModifyOrder(OrderModify orderModify, ExecutionReport &report)
+{
+    AllocationScope allocationScope{AllocationSite::ModifyOrder};
+    std::scoped_lock ordersLock{ordersMutex_};
+
+    auto entry = orders_.find(orderModify.GetOrderId());
+    if (entry == orders_.end())
+    {
+        report.RejectOrder(orderModify.GetOrderId(), orderModify.GetSide(), orderModify.GetQuantity(), OrderStatus{RejectReason::UnknownOrder});
+        return;
+    }
+
+    const auto orderType = entry->second.order_->GetOrderType();
+    const auto ownerId = entry->second.order_->GetOwnerId();
+
+    // the cancel and the add happen under one lock, pegs are repriced once after the add
+    CancelOrderEntry(entry->second);
+    OrderStatus status;
+    executionReport_ = &report;
+    AddOrderInternal(orderModify.ToOrderPointer(orderType, ownerId, &orderResource_), nullptr, status);
+    executionReport_ = nullptr;
+
+    if (!status.IsAccepted())
+        report.RejectOrder(orderModify.GetOrderId(), orderModify.GetSide(), orderModify.GetQuantity(), status);
+}
+
+template <MatchingPolicy Policy>
+OrderIds BasicOrderBook<Policy>::CancelAllForOwner(OwnerId ownerId)
+{
+    return MassCancel(ownerId, MassCancelFilter{});
+}
+
+template <MatchingPolicy Policy>
+OrderIds BasicOrderBook<Policy>::MassCancel(OwnerId ownerId, const MassCancelFilter &filter)
+{
+    AllocationScope allocationScope{AllocationSite::MassCancel};
+    std::scoped_lock ordersLock{ordersMutex_};
+
+    OrderIds orderIds;
+    auto owner = owners_.find(ownerId);
+    if (owner == owners_.end())
+        return orderIds;
+
+    orderIds.reserve(owner->second.count_);
+
+    // walk the owner's own list, cancelling unlinks the entry (and the owner once it is empty) so step to the next one first
+    for (auto *entry = owner->second.first_; entry != nullptr;)
+    {
+        auto *next = entry->nextOwned_;
+        if (filter.Matches(*entry->order_))
+        {
+            const auto orderId = entry->order_->GetOrderId();
+            orderIds.push_back(orderId);
+            CancelOrderInternal(orderId);
+        }
+        entry = next;
+    }
+    RepricePegs(pegTrades_);
+
+    return orderIds;
+}
+
+template <MatchingPolicy Policy>
+bool BasicOrderBook<Policy>::CancelOrder(OrderHandle handle)
+{
+    AllocationScope allocationScope{AllocationSite::CancelOrder};
+    std::scoped_lock ordersLock{ordersMutex_};
+
+    auto *entry = ResolveHandle(handle);
+    if (entry == nullptr)
+        return false;
+
+    CancelOrderEntry(*entry);
+    RepricePegs(pegTrades_);
+    return true;
 }
 
-void OrderBook::CancelOrder(OrderId orderId)
+template <MatchingPolicy Policy>
+Trades BasicOrderBook<Policy>::ModifyOrder(OrderHandle &handle, OrderModify orderModify)
 {
+    AllocationScope allocationScope{AllocationSite::ModifyOrder};
+    std::scoped_lock ordersLock{ordersMutex_};
+
+    // a stale handle changes nothing and is cleared, one for a different order than the modify names changes nothing and is
+    // left alone since its order still rests
+    auto *entry = ResolveHandle(handle);
+    if (entry == nullptr)
+    {
+        handle = OrderHandle{};
+        return {};
+    }
+    if (entry->order_->GetOrderId() != orderModify.GetOrderId())
+        return {};
+
+    const auto orderType = entry->order_->GetOrderType();
+    const auto ownerId = entry->order_->GetOwnerId();
+
+    // unlike the order id version, the cancel and the add happen under one lock
+    CancelOrderEntry(*entry);
+    OrderStatus status;
+    return AddOrderInternal(orderModify.ToOrderPointer(orderType, ownerId, &orderResource_), &handle, status);
+}
+
+template <MatchingPolicy Policy>
+void BasicOrderBook<Policy>::CancelOrder(OrderId orderId)
+{
+    AllocationScope allocationScope{AllocationSite::CancelOrder};
     std::scoped_lock ordersLock{ordersMutex_};
     CancelOrderInternal(orderId);
+    RepricePegs(pegTrades_);
 };
 
-std::size_t OrderBook::Size() const
+template <MatchingPolicy Policy>
+Trades BasicOrderBook<Policy>::MassQuote(OwnerId ownerId, const Quotes &quotes)
+{
+    AllocationScope allocationScope{AllocationSite::MassQuote};
+    std::scoped_lock ordersLock{ordersMutex_};
+
+    if (ownerId == Constants::NoOwner)
+        return {};
+
+    // a quote set is a handful of levels, so the checks and the diff below compare quotes pairwise instead of building maps
+    std::optional<Price> highestBid, lowestAsk;
+    for (std::size_t i = 0; i < quotes.size(); i++)
+    {
+        const auto &quote = quotes[i];
+        for (std::size_t j = 0; j < i; j++)
+        {
+            if (quotes[j].side_ == quote.side_ && quotes[j].price_ == quote.price_)
+                return {};
+        }
+
+        if (quote.quantity_ == 0)
+            continue;
+        if (quote.side_ == Side::Buy)
+            highestBid = std::max(highestBid.value_or(quote.price_), quote.price_);
+        else
+            lowestAsk = std::min(lowestAsk.value_or(quote.price_), quote.price_);
+    }
+    if (highestBid && lowestAsk && *highestBid >= *lowestAsk)
+        return {};
+
+    quoteMatched_.assign(quotes.size(), 0);
+
+    // the owner's resting quotes, each is kept, resized or cancelled. cancelling unlinks the entry so step to the next one first
+    if (auto owner = owners_.find(ownerId); owner != owners_.end())
+    {
+        for (auto *entry = owner->second.first_; entry != nullptr;)
+        {
+            auto *next = entry->nextOwned_;
+            if (entry->isQuote_)
+            {
+                const auto &order = *entry->order_;
+                std::size_t match = quotes.size();
+                for (std::size_t i = 0; i < quotes.size(); i++)
+                {
+                    if (!quoteMatched_[i] && quotes[i].side_ == order.GetSide() && quotes[i].price_ == order.GetPrice())
+                    {
+                        match = i;
+                        break;
+                    }
+                }
+
+                if (match == quotes.size() || quotes[match].quantity_ == 0)
+                {
+                    CancelOrderEntry(*entry);
+                }
+                else
+                {
+                    quoteMatched_[match] = 1;
+                    const auto &quote = quotes[match];
+                    if (quote.quantity_ < order.GetRemainingQuantity())
+                    {
+                        ResizeOrder(*entry, quote.quantity_);
+                    }
+                    else if (quote.quantity_ > order.GetRemainingQuantity())
+                    {
+                        // a larger size is checked like a cancel and an add, the old size is taken out of the owner's open
+                        // quantity for the check so it is not counted next to the new one
+                        Order resized{OrderType::GoodTillCancel, order.GetOrderId(), quote.side_, quote.price_, quote.quantity_, ownerId};
+                        riskGate_.OnOrderRemoved(order);
+                        const auto check = riskGate_.Check(resized, GetRiskReferencePrice(quote.side_));
+                        riskGate_.OnOrderAdded(order);
+                        if (check == RiskCheck::Passed)
+                            ResizeOrder(*entry, quote.quantity_);
+                    }
+                }
+            }
+            entry = next;
+        }
+    }
+
+    // the new levels are entered without matching, a quote whose order id is taken or that fails the risk checks is left out.
+    // the book was not crossed before and the quotes cannot cross each other, so at most one side of the new quotes crosses
+    std::optional<Side> aggressorSide;
+    for (std::size_t i = 0; i < quotes.size(); i++)
+    {
+        const auto &quote = quotes[i];
+        if (quoteMatched_[i] || quote.quantity_ == 0 || orders_.contains(quote.orderId_))
+            continue;
+
+        auto order = std::allocate_shared<Order>(std::pmr::polymorphic_allocator<Order>{&orderResource_}, OrderType::GoodTillCancel, quote.orderId_, quote.side_, quote.price_, quote.quantity_, ownerId);
+        if (riskGate_.Check(*order, GetRiskReferencePrice(quote.side_)) != RiskCheck::Passed)
+            continue;
+
+        if (CanMatch(quote.side_, quote.price_))
+            aggressorSide = quote.side_;
+
+        InsertOrder(order).isQuote_ = true;
+    }
+
+    Trades trades;
+    if (aggressorSide)
+        trades = MatchOrder(*aggressorSide);
+    RepricePegs(trades);
+    PrependPegTrades(trades);
+    return trades;
+}
+
+template <MatchingPolicy Policy>
+std::size_t BasicOrderBook<Policy>::Size() const
 {
     std::scoped_lock ordersLock{ordersMutex_};
     return orders_.size();
 }
 
-OrderbookLevelInfos OrderBook::GetOrderInfos() const
+template <MatchingPolicy Policy>
+std::size_t BasicOrderBook<Policy>::GetBidLevelCount() const
+{
+    std::scoped_lock ordersLock{ordersMutex_};
+    return bids_.size();
+}
+
+template <MatchingPolicy Policy>
+std::size_t BasicOrderBook<Policy>::GetAskLevelCount() const
+{
+    std::scoped_lock ordersLock{ordersMutex_};
+    return asks_.size();
+}
+
+template <MatchingPolicy Policy>
+OrderbookLevelInfos BasicOrderBook<Policy>::GetOrderInfos() const
 {
     LevelInfos bidInfos, askInfos;
     bidInfos.reserve(orders_.size());
     askInfos.reserve(orders_.size());
 
     // lambda function which returns the total quantity ordered from each price level in the bid/ask map
-    auto CreateLevelInfos = [](Price price, const OrderPointers &orders)
+    auto CreateLevelInfos = [](Price price, const PriceLevel &level)
     {
         return LevelInfo{
-            price, std::accumulate(orders.begin(), orders.end(), (Quantity)0, [](Quantity runningSum, const OrderPointer &order)
+            price, std::accumulate(level.orders_.begin(), level.orders_.end(), (Quantity)0, [](Quantity runningSum, const OrderPointer &order)
                                    { return runningSum + order->GetRemainingQuantity(); })};
     };
 
-    for (const auto &[price, orders] : bids_)
+    for (const auto &[price, level] : bids_)
     {
-        bidInfos.push_back(CreateLevelInfos(price, orders));
+        bidInfos.push_back(CreateLevelInfos(price, level));
     };
 
-    for (const auto &[price, orders] : asks_)
+    for (const auto &[price, level] : asks_)
     {
-        askInfos.push_back(CreateLevelInfos(price, orders));
+        askInfos.push_back(CreateLevelInfos(price, level));
     };
 
     return OrderbookLevelInfos{bidInfos, askInfos};
 }
+
+template <MatchingPolicy Policy>
+TradeStatistics BasicOrderBook<Policy>::GetSessionStatistics() const
+{
+    std::scoped_lock ordersLock{ordersMutex_};
+    return tradeAnalytics_.GetSession();
+}
+
+template <MatchingPolicy Policy>
+TradeStatistics BasicOrderBook<Policy>::GetCurrentBar(std::chrono::nanoseconds interval) const
+{
+    std::scoped_lock ordersLock{ordersMutex_};
+    return tradeAnalytics_.GetCurrentBar(interval, clock_.Now());
+}
+
+template <MatchingPolicy Policy>
+void BasicOrderBook<Policy>::FlushTradeBars(TradeBars &bars)
+{
+    std::scoped_lock ordersLock{ordersMutex_};
+    tradeAnalytics_.FlushBars(bars, clock_.Now());
+}
+
+template <MatchingPolicy Policy>
+std::uint64_t BasicOrderBook<Policy>::GetDroppedBarCount() const
+{
+    std::scoped_lock ordersLock{ordersMutex_};
+    return tradeAnalytics_.GetDroppedBarCount();
+}
+
+template <MatchingPolicy Policy>
+void BasicOrderBook<Policy>::ResetTradeSession()
+{
+    std::scoped_lock ordersLock{ordersMutex_};
+    tradeAnalytics_.ResetSession();
+}
+
+template class BasicOrderBook<FifoMatching>;
+template class BasicOrderBook<ProRataMatching>;
+template class BasicOrderBook<HybridMatching>;
\ No newline at end of file
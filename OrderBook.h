@@ -6,22 +6,139 @@
 #include <condition_variable>
 #include <mutex>
 #include <atomic>
+#include <memory_resource>
+#include <optional>
+#include <compare>
 
 #include "Usings.h"
 #include "Order.h"
 #include "OrderModify.h"
-#include "OrderbookLevelInfos.h"
+#include "OrderBookLevelInfos.h"
 #include "Trade.h"
+#include "OrderHandle.h"
+#include "TradeAnalytics.h"
+#include "MatchingPolicy.h"
+#include "RiskGate.h"
+#include "QueuePosition.h"
+#include "PegReference.h"
+#include "ExecutionReport.h"
+#include "SessionClock.h"
+#include "OrderStatus.h"
 
 using OrderIds = std::vector<OrderId>;
 
-class OrderBook
+class MarketDataPublisher;
+
+// sizes the book is prepared for up front. a book that stays within them makes no heap allocations of its own once constructed,
+// apart from the Trades it returns
+struct OrderBookCapacity
+{
+    std::size_t maxOrders_{};
+    std::size_t maxLevels_{};
+    std::size_t maxOwners_{};
+};
+
+// narrows a mass cancel down to one side and/or an inclusive price range, an empty filter matches every order
+struct MassCancelFilter
+{
+    std::optional<Side> side_;
+    std::optional<Price> minPrice_;
+    std::optional<Price> maxPrice_;
+
+    bool Matches(const Order &order) const
+    {
+        return (!side_ || order.GetSide() == *side_) && (!minPrice_ || order.GetPrice() >= *minPrice_) && (!maxPrice_ || order.GetPrice() <= *maxPrice_);
+    }
+};
+
+// one level of a two sided quote. the order id is only used when the level has to be entered as a new order
+struct Quote
+{
+    Side side_;
+    Price price_;
+    Quantity quantity_;
+    OrderId orderId_;
+};
+
+using Quotes = std::vector<Quote>;
+
+template <MatchingPolicy Policy>
+class BasicOrderBook
 {
 private:
+    static constexpr std::uint32_t NoHandle = std::numeric_limits<std::uint32_t>::max();
+    // sequence numbers a level starts out with, the queue index grows when a level holds more orders
+    static constexpr std::size_t MinQueueCapacity = 16;
+
+    // the orders resting at one price in time priority, and the index that answers queue position queries for them
+    struct PriceLevel
+    {
+        using allocator_type = std::pmr::polymorphic_allocator<>;
+
+        explicit PriceLevel(const allocator_type &allocator) : orders_{allocator}, queue_{allocator} {}
+        PriceLevel(const PriceLevel &other, const allocator_type &allocator) : orders_{other.orders_, allocator}, queue_{other.queue_, allocator}, peggedCount_{other.peggedCount_} {}
+        PriceLevel(PriceLevel &&other, const allocator_type &allocator) : orders_{std::move(other.orders_), allocator}, queue_{std::move(other.queue_), allocator}, peggedCount_{other.peggedCount_} {}
+
+        OrderPointers orders_;
+        LevelQueueIndex queue_;
+        // how many of the orders are pegged, a level holding nothing else does not set a peg reference price
+        std::size_t peggedCount_{};
+    };
+
+    struct OrderEntry;
+
+    // pegged orders with the same reference, side and offset always rest at the same price, so they are repriced as one group.
+    // ordered by reference first, so the groups following one reference price are next to each other in the map
+    struct PegKey
+    {
+        PegReference reference_;
+        Side side_;
+        Price offset_;
+
+        auto operator<=>(const PegKey &) const = default;
+    };
+
+    struct PegGroup
+    {
+        Price price_{};
+        // the group's orders in time priority, linked through their entries
+        OrderEntry *first_{nullptr};
+        OrderEntry *last_{nullptr};
+        std::size_t count_{};
+    };
+
     struct OrderEntry
     {
         OrderPointer order_{nullptr};
         OrderPointers::iterator location_;
+        // the price level the order rests in, map nodes never move so this stays valid while the order rests
+        PriceLevel *level_{nullptr};
+        // quantity that joined the level before this order, for its queue position
+        std::uint64_t queueOffset_{};
+        // slot in handleSlots_, only taken when the caller asked for a handle
+        std::uint32_t handleIndex_{NoHandle};
+        // entered through MassQuote, the next mass quote from the owner replaces it
+        bool isQuote_{false};
+        // intrusive links through all orders of the same owner, safe because unordered_map never moves its nodes
+        OrderEntry *previousOwned_{nullptr};
+        OrderEntry *nextOwned_{nullptr};
+        // the peg group of a pegged order and its links through the group, the group is a map node and never moves
+        PegGroup *pegGroup_{nullptr};
+        OrderEntry *previousPegged_{nullptr};
+        OrderEntry *nextPegged_{nullptr};
+    };
+
+    struct OwnerOrders
+    {
+        OrderEntry *first_{nullptr};
+        std::size_t count_{};
+    };
+
+    struct HandleSlot
+    {
+        std::uint32_t generation_{1};
+        std::uint32_t nextFree_{NoHandle};
+        OrderEntry *entry_{nullptr};
     };
 
     struct LevelData
@@ -38,10 +155,33 @@ private:
         };
     };
 
-    std::unordered_map<Price, LevelData> data_;
-    std::map<Price, OrderPointers, std::greater<Price>> bids_;
-    std::map<Price, OrderPointers, std::less<Price>> asks_;
-    std::unordered_map<OrderId, OrderEntry> orders_;
+    // node memory for the containers below. freed nodes go back into the pool rather than to the global allocator,
+    // it has to be declared first so it outlives every container that uses it. only touched with the orders mutex held
+    std::pmr::unsynchronized_pool_resource nodeResource_;
+    // memory for the orders ModifyOrder creates, synchronized because the last reference to an order can be dropped outside the mutex
+    std::pmr::synchronized_pool_resource orderResource_;
+
+    std::pmr::unordered_map<Price, LevelData> data_{&nodeResource_};
+    std::pmr::map<Price, PriceLevel, std::greater<Price>> bids_{&nodeResource_};
+    std::pmr::map<Price, PriceLevel, std::less<Price>> asks_{&nodeResource_};
+    std::pmr::unordered_map<OrderId, OrderEntry> orders_{&nodeResource_};
+    std::pmr::unordered_map<OwnerId, OwnerOrders> owners_{&nodeResource_};
+    std::pmr::vector<HandleSlot> handleSlots_{&nodeResource_};
+    std::uint32_t freeHandleSlot_{NoHandle};
+    std::pmr::map<PegKey, PegGroup> pegGroups_{&nodeResource_};
+    // the unpegged best prices every peg group was last priced from, groups only move when these do
+    std::optional<Price> pegBestBid_;
+    std::optional<Price> pegBestAsk_;
+
+    // trades pegs made while being repriced after a cancel, handed out with the next trades the book returns
+    Trades pegTrades_;
+
+    // scratch space for sharing out a level under a pro rata policy, reused across matches
+    std::vector<Quantity> proRataQuantities_;
+    std::vector<Quantity> proRataAllocations_;
+
+    // which of the incoming quotes already rest in the book, reused across mass quotes
+    std::vector<std::uint8_t> quoteMatched_;
 
     // these data structures are for the pruning thread and avoiding race conditions
     mutable std::mutex ordersMutex_;
@@ -49,11 +189,34 @@ private:
     std::condition_variable shutdownConditionVariable_;
     std::atomic<bool> shutdown_{false};
 
+    // the wall clock unless a replay swapped in a simulated one, trades are stamped with it
+    SessionClock clock_;
+    // when good for day orders next expire, only kept for a simulated clock
+    SessionClock::Clock::time_point nextSessionEnd_{};
+
+    // session and interval statistics, updated for every fill
+    TradeAnalytics tradeAnalytics_;
+
+    // pre trade checks, every order passes until limits are set
+    RiskGate riskGate_;
+
+    // optional, receives every trade and every change to a price level's quantity
+    MarketDataPublisher *marketDataPublisher_{nullptr};
+
+    // set for the duration of a call in execution report mode, fills go here instead of into Trades
+    ExecutionReport *executionReport_{nullptr};
+
+    static std::pmr::pool_options MakeNodePoolOptions(const OrderBookCapacity &capacity);
+
     void PruneGoodForDayOrders();
+    void StopPruneThread();
 
     bool CanMatch(Side side, Price price) const;
-    Trades MatchOrder();
+    Trades MatchOrder(Side aggressorSide);
+    void FillOrders(PriceLevel &bidLevel, Order &bid, PriceLevel &askLevel, Order &ask, Price bidPrice, Price askPrice, Quantity quantity, Side aggressorSide, Trades &trades, TradeAnalytics::Clock::time_point &matchTime);
+    bool MatchProRata(Side aggressorSide, Price bidPrice, PriceLevel &bidLevel, Price askPrice, PriceLevel &askLevel, Trades &trades, TradeAnalytics::Clock::time_point &matchTime);
     bool CanFullyFill(Side side, Price price, Quantity quantity) const;
+    std::optional<Price> GetRiskReferencePrice(Side side) const;
 
     // these methods are for maintaining the metadata for each price level in the orderbook
     void OnOrderAdded(OrderPointer order);
@@ -61,14 +224,133 @@ private:
     void OnOrderMatched(Side side, Price price, Quantity quantity, bool isFullyFilled);
     void UpdateLevelData(Side side, Price price, Quantity quantity, LevelData::Action action);
 
-    void CancelOrders(OrderIds orderIds);
+    // these methods keep the owner index in step with orders_
+    void LinkOwner(OrderEntry &entry);
+    void UnlinkOwner(OrderEntry &entry);
+    void UnlinkOrderEntry(OrderEntry &entry);
+    void EraseOrderEntry(OrderId orderId);
+    void EraseOrderEntry(OrderEntry &entry);
+
+    // these methods keep pegged orders at their reference price
+    static bool IsPassivePeg(const PegKey &key);
+    static std::optional<Price> GetPegPrice(const PegKey &key, std::optional<Price> bestBid, std::optional<Price> bestAsk);
+    template <typename Levels>
+    static std::optional<Price> GetUnpeggedBest(const Levels &levels);
+    void LinkPeg(OrderEntry &entry, PegGroup &group);
+    void UnlinkPeg(OrderEntry &entry);
+    void MovePegGroup(Side side, PegGroup &group, Price price);
+    void RepricePegs(Trades &trades);
+    void RepricePegGroups(PegReference reference, std::optional<Price> bestBid, std::optional<Price> bestAsk, std::optional<Side> &aggressorSide);
+    void PrependPegTrades(Trades &trades);
+
+    // these methods hand out and check the generation counted slots behind an OrderHandle
+    OrderHandle AcquireHandle(OrderEntry &entry);
+    void ReleaseHandle(std::uint32_t index);
+    OrderEntry *ResolveHandle(OrderHandle handle) const;
+
+    Trades AddOrderInternal(OrderPointer order, OrderHandle *handle, OrderStatus &status);
+    OrderEntry &InsertOrder(OrderPointer order);
+    void ResizeOrder(OrderEntry &entry, Quantity quantity);
+    void EnqueueOrder(PriceLevel &level, Order &order, OrderEntry &entry);
+    void CancelOrderEntry(OrderEntry &entry);
+
+    OrderIds ExpireGoodForDayOrders();
     void CancelOrderInternal(OrderId orderId);
 
 public:
+    explicit BasicOrderBook(const OrderBookCapacity &capacity = {});
+    // stops and joins the thread expiring good for day orders
+    ~BasicOrderBook();
+
+    // event driven mode for replaying history: the wall clock is replaced by a simulated one starting at start, which only moves
+    // with AdvanceTime. trades are stamped with simulated time, and good for day orders expire inline as soon as time reaches the
+    // session close rather than on a thread sleeping until it
+    void UseSimulatedClock(SessionClock::Clock::time_point start, std::chrono::nanoseconds sessionClose = SessionClock::DefaultSessionClose);
+    // moves simulated time forward, call it with each command's timestamp before applying the command. if a session close is
+    // passed, the good for day orders resting at the close are cancelled first and their ids returned, in order id order
+    OrderIds AdvanceTime(SessionClock::Clock::time_point now);
+    // the time the book stamps its trades with, simulated time in a replay
+    SessionClock::Clock::time_point GetTime() const;
+
+    // the publisher is called with the orders mutex held, so it only ever sees a single producer
+    void SetMarketDataPublisher(MarketDataPublisher *publisher);
+
+    // an order failing a limit is rejected before it can match, the same way as a duplicate order id. limits only apply to orders
+    // added after they are set, and an owner's open quantity only counts orders added after the owner was given limits
+    void SetRiskLimits(const RiskLimits &limits);
+    void SetOwnerRiskLimits(OwnerId ownerId, const OwnerRiskLimits &limits);
+    RiskRejections GetRiskRejections() const;
+
     Trades AddOrder(OrderPointer order);
     void CancelOrder(OrderId orderId);
     Trades ModifyOrder(OrderModify orderModify);
 
+    // same operations, status says whether the book took the order and if not why. an order that rests without trading and
+    // one that was rejected both return no trades. a modify whose replacement is rejected leaves the old order cancelled
+    Trades AddOrder(OrderPointer order, OrderStatus &status);
+    Trades ModifyOrder(OrderModify orderModify, OrderStatus &status);
+
+    // a pegged order rests at its reference price plus offset and follows the reference as the book changes. pegs may only be
+    // passive: bids pegged to the best bid or the midpoint with an offset of zero or less, asks pegged to the best ask or the
+    // midpoint with an offset of zero or more. the midpoint rounds down for bids and up for asks, so midpoint pegs on both sides
+    // only trade with each other when the spread is an even number of ticks. only good till cancel and good for day orders can
+    // be pegged, and a peg whose reference price does not exist is rejected. modifying a pegged order turns it into a limit order
+    Trades AddPeggedOrder(OrderPointer order, PegReference reference, Price offset);
+
+    // execution report mode: nothing is returned, the order gets one summary in the report and each fill a compact notice.
+    // a rejected order, a modify of an order that is not resting included, gets a summary holding the reason. a peg that crosses
+    // after being repriced gets a summary of its own, trades pegs made while repricing after an earlier cancel stay with
+    // TakePegTrades
+    void AddOrder(OrderPointer order, ExecutionReport &report);
+    void ModifyOrder(OrderModify orderModify, ExecutionReport &report);
+
+    // trades made by pegs repriced after a cancel or mass cancel. the next AddOrder, AddPeggedOrder, ModifyOrder or MassQuote
+    // returns them ahead of its own trades unless they were taken here first
+    Trades TakePegTrades();
+
+    // same operations through a handle. the handle is only valid while the order rests, cancelling a stale handle returns false
+    // and modifying it does nothing. a modify replaces the handle with one for the new order, one naming a different order id
+    // than the handle's does nothing and keeps the handle. the order's id is only hashed once, when orders_ erases it
+    Trades AddOrder(OrderPointer order, OrderHandle &handle);
+    bool CancelOrder(OrderHandle handle);
+    Trades ModifyOrder(OrderHandle &handle, OrderModify orderModify);
+
+    // cancel every order of one owner, or only those matching the filter, under a single lock.
+    // runs in time proportional to the owner's orders and returns the ids that were cancelled
+    OrderIds CancelAllForOwner(OwnerId ownerId);
+    OrderIds MassCancel(OwnerId ownerId, const MassCancelFilter &filter);
+
+    // orders and quantity resting in front of the order at its price level, empty if the order is not resting
+    std::optional<QueuePosition> GetQueuePosition(OrderId orderId) const;
+
+    // replaces all of an owner's quotes with this set under one lock, and matches once at the end. a level whose side, price and
+    // quantity are unchanged keeps its queue priority, a smaller quantity is applied in place and keeps it too, a larger one moves
+    // the order to the back of its level and passes the risk checks as a cancel and an add of the new size would. levels that are
+    // left out or have no quantity are cancelled. a set with two quotes for one level or bids at or above its asks is rejected
+    Trades MassQuote(OwnerId ownerId, const Quotes &quotes);
+
     std::size_t Size() const;
+    // number of price levels per side, cheap alternative to GetOrderInfos when only the level counts are needed
+    std::size_t GetBidLevelCount() const;
+    std::size_t GetAskLevelCount() const;
     OrderbookLevelInfos GetOrderInfos() const;
+
+    // trades print at the resting order's price and are buy or sell initiated by the side of the incoming order. a bar is closed
+    // by the first trade, flush or AdvanceTime after its interval, and the current bar is empty once its interval is over
+    TradeStatistics GetSessionStatistics() const;
+    TradeStatistics GetCurrentBar(std::chrono::nanoseconds interval) const;
+    void FlushTradeBars(TradeBars &bars);
+    // closed bars lost because the pending ring filled up before they were flushed
+    std::uint64_t GetDroppedBarCount() const;
+    // forgets the session statistics and all bars
+    void ResetTradeSession();
 };
+
+// the definitions live in OrderBook.cpp, which instantiates the book for each policy
+extern template class BasicOrderBook<FifoMatching>;
+extern template class BasicOrderBook<ProRataMatching>;
+extern template class BasicOrderBook<HybridMatching>;
+
+using OrderBook = BasicOrderBook<FifoMatching>;
+using ProRataOrderBook = BasicOrderBook<ProRataMatching>;
+using HybridOrderBook = BasicOrderBook<HybridMatching>;
@@ -0,0 +1,21 @@
+#pragma once
+
+#include <concepts>
+#include <cstddef>
+
+#include "Usings.h"
+#include "Order.h"
+#include "OrderModify.h"
+#include "OrderBookLevelInfos.h"
+#include "Trade.h"
+
+// the operations every order book implementation must provide, so experimental backends can be swapped in for OrderBook
+// and run against it through the differential harness in BookDifferential.h
+template <typename Book>
+concept OrderBookBackend = requires(Book &book, const Book &constBook, OrderPointer order, OrderId orderId, OrderModify orderModify) {
+    { book.AddOrder(order) } -> std::same_as<Trades>;
+    { book.CancelOrder(orderId) } -> std::same_as<void>;
+    { book.ModifyOrder(orderModify) } -> std::same_as<Trades>;
+    { constBook.Size() } -> std::convertible_to<std::size_t>;
+    { constBook.GetOrderInfos() } -> std::same_as<OrderbookLevelInfos>;
+};
@@ -1,3 +1,5 @@
+#pragma once
+
 #include "LevelInfo.h"
 
 class OrderbookLevelInfos
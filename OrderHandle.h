@@ -0,0 +1,27 @@
+#pragma once
+
+#include <cstdint>
+
+#include "MatchingPolicy.h"
+
+template <MatchingPolicy Policy>
+class BasicOrderBook;
+
+// refers straight to a resting order, so cancel and modify can skip the order id and price level lookups.
+// when the order leaves the book its slot moves on to a new generation, so a stale handle is detected without touching the order
+class OrderHandle
+{
+public:
+    OrderHandle() = default;
+
+    bool IsValid() const { return generation_ != 0; }
+
+private:
+    template <MatchingPolicy Policy>
+    friend class BasicOrderBook;
+
+    OrderHandle(std::uint32_t index, std::uint32_t generation) : index_{index}, generation_{generation} {}
+
+    std::uint32_t index_{};
+    std::uint32_t generation_{};
+};
@@ -19,6 +19,12 @@ public:
         return std::make_shared<Order>(type, GetOrderId(), GetSide(), GetPrice(), GetQuantity());
     };
 
+    // same as above for an owned order, with the order and its shared_ptr control block carved out of the given memory resource
+    OrderPointer ToOrderPointer(OrderType type, OwnerId ownerId, std::pmr::memory_resource *resource)
+    {
+        return std::allocate_shared<Order>(std::pmr::polymorphic_allocator<Order>{resource}, type, GetOrderId(), GetSide(), GetPrice(), GetQuantity(), ownerId);
+    };
+
 private:
     OrderId orderId_;
     Side side_;
@@ -0,0 +1,33 @@
+#pragma once
+
+#include <cstdint>
+
+#include "RiskGate.h"
+
+// why the book turned an order down
+enum class RejectReason : std::uint8_t
+{
+    None,
+    DuplicateOrderId,
+    // no quantity, or a side or order type the book does not know
+    InvalidOrder,
+    // a modify for an order that is not resting
+    UnknownOrder,
+    // a market order with nothing on the other side to price it from
+    NoLiquidity,
+    // a fill and kill order with nothing to match against
+    CannotMatch,
+    // a fill or kill order the book cannot fill in full
+    CannotFullyFill,
+    RiskCheck,
+};
+
+// what the book did with one order, the trades it made are returned as usual
+struct OrderStatus
+{
+    RejectReason reason_{RejectReason::None};
+    // the limit the order failed when the reason is RiskCheck
+    RiskCheck riskCheck_{RiskCheck::Passed};
+
+    bool IsAccepted() const { return reason_ == RejectReason::None; }
+};
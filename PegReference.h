@@ -0,0 +1,11 @@
+#pragma once
+
+#include <cstdint>
+
+// the price a pegged order follows, always taken from orders that are not pegged themselves
+enum class PegReference : std::uint8_t
+{
+    BestBid,
+    BestAsk,
+    Midpoint,
+};
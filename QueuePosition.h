@@ -0,0 +1,86 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <memory_resource>
+#include <vector>
+
+#include "Usings.h"
+
+// how much of a price level is in front of a resting order
+struct QueuePosition
+{
+    std::size_t ordersAhead_;
+    std::uint64_t quantityAhead_;
+};
+
+// answers queue position queries for one price level in logarithmic time. every order gets a sequence number and remembers how much
+// quantity had joined the level before it. a fenwick tree over the sequence numbers adds up what has left the level since, filled or
+// cancelled, so what is still ahead is the difference. joining the level is constant time, only reductions touch the tree.
+// sequence numbers run up to the capacity, the book then renumbers the orders still resting and starts over
+class LevelQueueIndex
+{
+public:
+    using allocator_type = std::pmr::polymorphic_allocator<>;
+
+    explicit LevelQueueIndex(const allocator_type &allocator = {}) : removed_{allocator} {}
+    LevelQueueIndex(const LevelQueueIndex &other, const allocator_type &allocator) : removed_{other.removed_, allocator}, nextSequence_{other.nextSequence_}, enqueuedQuantity_{other.enqueuedQuantity_} {}
+    LevelQueueIndex(LevelQueueIndex &&other, const allocator_type &allocator) : removed_{std::move(other.removed_), allocator}, nextSequence_{other.nextSequence_}, enqueuedQuantity_{other.enqueuedQuantity_} {}
+
+    bool IsFull() const { return nextSequence_ == removed_.size(); }
+
+    // bytes the index allocates for capacity sequence numbers
+    static constexpr std::size_t GetAllocationSize(std::size_t capacity) { return capacity * sizeof(Removed); }
+
+    // forgets every order and makes room for at least capacity sequence numbers, memory the index already has is kept and used
+    void Reset(std::size_t capacity)
+    {
+        removed_.assign(std::max(capacity, removed_.capacity()), Removed{});
+        nextSequence_ = 0;
+        enqueuedQuantity_ = 0;
+    }
+
+    // the index must not be full. returns the order's sequence number, offset is set to the quantity that joined before it
+    std::uint32_t Enqueue(Quantity quantity, std::uint64_t &offset)
+    {
+        offset = enqueuedQuantity_;
+        enqueuedQuantity_ += quantity;
+        return nextSequence_++;
+    }
+
+    // quantity left the level from the order with this sequence number, a fill, a size reduction or the rest of it on cancel
+    void Remove(std::uint32_t sequence, Quantity quantity, bool isOrderGone)
+    {
+        for (std::size_t i = sequence + 1; i <= removed_.size(); i += i & (~i + 1))
+        {
+            removed_[i - 1].quantity_ += quantity;
+            removed_[i - 1].count_ += isOrderGone ? 1 : 0;
+        }
+    }
+
+    QueuePosition GetPosition(std::uint32_t sequence, std::uint64_t offset) const
+    {
+        std::uint64_t removedQuantity = 0;
+        std::size_t removedCount = 0;
+        for (std::size_t i = sequence; i > 0; i -= i & (~i + 1))
+        {
+            removedQuantity += removed_[i - 1].quantity_;
+            removedCount += removed_[i - 1].count_;
+        }
+        return QueuePosition{sequence - removedCount, offset - removedQuantity};
+    }
+
+private:
+    struct Removed
+    {
+        std::uint64_t quantity_;
+        std::uint32_t count_;
+    };
+
+    static_assert(sizeof(Removed) == 16);
+
+    std::pmr::vector<Removed> removed_;
+    std::uint32_t nextSequence_{};
+    std::uint64_t enqueuedQuantity_{};
+};
@@ -0,0 +1,181 @@
+#include "ReferenceOrderBook.h"
+
+#include <algorithm>
+
+bool ReferenceOrderBook::CanMatch(Side side, Price price) const
+{
+    if (side == Side::Buy)
+        return !asks_.empty() && price >= asks_.front().price_;
+
+    return !bids_.empty() && price <= bids_.front().price_;
+}
+
+bool ReferenceOrderBook::CanFullyFill(Side side, Price price, Quantity quantity) const
+{
+    if (!CanMatch(side, price))
+        return false;
+
+    // add up the opposite quantity at every level this order would cross
+    const auto &levels = side == Side::Buy ? asks_ : bids_;
+    Quantity available{};
+
+    for (const auto &level : levels)
+    {
+        if ((side == Side::Buy && level.price_ > price) || (side == Side::Sell && level.price_ < price))
+            break;
+
+        for (const auto &order : level.orders_)
+            available += order->GetRemainingQuantity();
+    }
+
+    return available >= quantity;
+}
+
+Trades ReferenceOrderBook::MatchOrder()
+{
+    Trades trades;
+
+    while (!bids_.empty() && !asks_.empty() && bids_.front().price_ >= asks_.front().price_)
+    {
+        auto &bids = bids_.front().orders_;
+        auto &asks = asks_.front().orders_;
+
+        while (!bids.empty() && !asks.empty())
+        {
+            auto bid = bids.front();
+            auto ask = asks.front();
+            Quantity quantity = std::min(bid->GetRemainingQuantity(), ask->GetRemainingQuantity());
+
+            bid->Fill(quantity);
+            ask->Fill(quantity);
+            trades.push_back(Trade{TradeInfo{bid->GetOrderId(), bid->GetPrice(), quantity}, TradeInfo{ask->GetOrderId(), ask->GetPrice(), quantity}});
+
+            if (bid->IsFilled())
+            {
+                bids.pop_front();
+                orders_.erase(bid->GetOrderId());
+            }
+            if (ask->IsFilled())
+            {
+                asks.pop_front();
+                orders_.erase(ask->GetOrderId());
+            }
+        }
+
+        if (bids.empty())
+            bids_.erase(bids_.begin());
+        if (asks.empty())
+            asks_.erase(asks_.begin());
+
+        // a fill and kill order left at the front of the best level after a sweep is cancelled, the same rule OrderBook applies
+        if (!bids_.empty() && bids_.front().orders_.front()->GetOrderType() == OrderType::FillAndKill)
+            CancelOrder(bids_.front().orders_.front()->GetOrderId());
+        if (!asks_.empty() && asks_.front().orders_.front()->GetOrderType() == OrderType::FillAndKill)
+            CancelOrder(asks_.front().orders_.front()->GetOrderId());
+    }
+
+    return trades;
+}
+
+Trades ReferenceOrderBook::AddOrder(OrderPointer order)
+{
+    if (orders_.contains(order->GetOrderId()))
+        return {};
+
+    if (order->GetOrderType() == OrderType::Market)
+    {
+        // the market order becomes a limit order at the worst opposite price
+        const auto &opposite = order->GetSide() == Side::Buy ? asks_ : bids_;
+        if (opposite.empty())
+            return {};
+        order->ToGoodTillCancel(opposite.back().price_);
+    }
+
+    if (order->GetOrderType() == OrderType::FillAndKill && !CanMatch(order->GetSide(), order->GetPrice()))
+        return {};
+
+    if (order->GetOrderType() == OrderType::FillOrKill && !CanFullyFill(order->GetSide(), order->GetPrice(), order->GetIntialQuantity()))
+        return {};
+
+    auto &levels = GetLevels(order->GetSide());
+    auto level = std::find_if(levels.begin(), levels.end(), [&](const Level &level)
+                              { return !IsBetter(order->GetSide(), level.price_, order->GetPrice()); });
+
+    if (level == levels.end() || level->price_ != order->GetPrice())
+        level = levels.insert(level, Level{order->GetPrice(), {}});
+
+    level->orders_.push_back(order);
+    orders_.insert({order->GetOrderId(), order});
+
+    return MatchOrder();
+}
+
+void ReferenceOrderBook::CancelOrder(OrderId orderId)
+{
+    auto found = orders_.find(orderId);
+    if (found == orders_.end())
+        return;
+
+    auto order = found->second;
+    orders_.erase(found);
+
+    auto &levels = GetLevels(order->GetSide());
+    auto level = std::find_if(levels.begin(), levels.end(), [&](const Level &level)
+                              { return level.price_ == order->GetPrice(); });
+
+    auto &orders = level->orders_;
+    orders.erase(std::find(orders.begin(), orders.end(), order));
+    if (orders.empty())
+        levels.erase(level);
+}
+
+Trades ReferenceOrderBook::ModifyOrder(OrderModify orderModify)
+{
+    auto found = orders_.find(orderModify.GetOrderId());
+    if (found == orders_.end())
+        return {};
+
+    const auto orderType = found->second->GetOrderType();
+    CancelOrder(orderModify.GetOrderId());
+    return AddOrder(orderModify.ToOrderPointer(orderType));
+}
+
+std::optional<QueuePosition> ReferenceOrderBook::GetQueuePosition(OrderId orderId) const
+{
+    auto found = orders_.find(orderId);
+    if (found == orders_.end())
+        return std::nullopt;
+
+    const auto &order = found->second;
+    const auto &levels = order->GetSide() == Side::Buy ? bids_ : asks_;
+    auto level = std::find_if(levels.begin(), levels.end(), [&](const Level &level)
+                              { return level.price_ == order->GetPrice(); });
+
+    QueuePosition position{0, 0};
+    for (const auto &ahead : level->orders_)
+    {
+        if (ahead == order)
+            break;
+        position.ordersAhead_++;
+        position.quantityAhead_ += ahead->GetRemainingQuantity();
+    }
+    return position;
+}
+
+OrderbookLevelInfos ReferenceOrderBook::GetOrderInfos() const
+{
+    auto CreateLevelInfos = [](const Levels &levels)
+    {
+        LevelInfos infos;
+        for (const auto &level : levels)
+        {
+            Quantity quantity{};
+            for (const auto &order : level.orders_)
+                quantity += order->GetRemainingQuantity();
+            infos.push_back(LevelInfo{level.price_, quantity});
+        }
+        return infos;
+    };
+
+    return OrderbookLevelInfos{CreateLevelInfos(bids_), CreateLevelInfos(asks_)};
+}
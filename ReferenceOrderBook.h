@@ -0,0 +1,50 @@
+#pragma once
+
+#include <deque>
+#include <optional>
+#include <vector>
+#include <unordered_map>
+
+#include "Usings.h"
+#include "Order.h"
+#include "OrderModify.h"
+#include "OrderBookLevelInfos.h"
+#include "Trade.h"
+#include "QueuePosition.h"
+
+// a deliberately simple, single threaded order book with the same matching rules as OrderBook.
+// levels are kept in sorted vectors (best price first) and every lookup is a linear scan, so it is slow but easy to check by eye.
+// it exists as the oracle for the differential harness in BookDifferential.h
+class ReferenceOrderBook
+{
+private:
+    struct Level
+    {
+        Price price_;
+        std::deque<OrderPointer> orders_;
+    };
+
+    using Levels = std::vector<Level>;
+
+    Levels bids_;
+    Levels asks_;
+    std::unordered_map<OrderId, OrderPointer> orders_;
+
+    Levels &GetLevels(Side side) { return side == Side::Buy ? bids_ : asks_; }
+    static bool IsBetter(Side side, Price price, Price other) { return side == Side::Buy ? price > other : price < other; }
+
+    bool CanMatch(Side side, Price price) const;
+    bool CanFullyFill(Side side, Price price, Quantity quantity) const;
+    Trades MatchOrder();
+
+public:
+    Trades AddOrder(OrderPointer order);
+    void CancelOrder(OrderId orderId);
+    Trades ModifyOrder(OrderModify orderModify);
+
+    std::size_t Size() const { return orders_.size(); }
+    bool Contains(OrderId orderId) const { return orders_.contains(orderId); }
+    // counts the orders in front of this one in its level
+    std::optional<QueuePosition> GetQueuePosition(OrderId orderId) const;
+    OrderbookLevelInfos GetOrderInfos() const;
+};
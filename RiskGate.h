@@ -0,0 +1,218 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <optional>
+#include <stdexcept>
+#include <unordered_map>
+#include <vector>
+
+#include "Usings.h"
+#include "Side.h"
+#include "Order.h"
+
+// the check an order failed, Passed when it may go on to matching
+enum class RiskCheck : std::uint8_t
+{
+    Passed,
+    PriceBand,
+    OrderQuantity,
+    Notional,
+    OpenQuantity,
+    Position,
+    Count,
+};
+
+// limits for every order in the book, a zero limit is not checked
+struct RiskLimits
+{
+    // how far an order may be priced from the reference price, the last trade or else the best price
+    Price priceBand_{};
+    Quantity maxOrderQuantity_{};
+    std::int64_t maxNotional_{};
+};
+
+// limits for one owner, a zero limit is not checked
+struct OwnerRiskLimits
+{
+    // quantity the owner has resting in the book, counting the new order
+    std::uint64_t maxOpenQuantity_{};
+    // net filled quantity, buys minus sells, the new order is counted as if it filled in full
+    std::int64_t maxPosition_{};
+};
+
+using RiskRejections = std::array<std::uint64_t, static_cast<std::size_t>(RiskCheck::Count)>;
+
+// pre trade checks run inline with the orders mutex held, before an order can match. the limits and the per owner state sit
+// together in one flat table with a slot for each owner that was given limits, so a check is a few compares on a single entry
+// and the table stays as small as the number of such owners, whatever their ids. the slot is looked up once, when an order is
+// checked, and kept in the order for the updates that follow. other owners only get the book wide checks
+class RiskGate
+{
+public:
+    // slots are 16 bits wide to fit in the order record
+    static constexpr std::size_t MaxOwners = std::numeric_limits<std::uint16_t>::max();
+
+    void SetLimits(const RiskLimits &limits)
+    {
+        limits_ = limits;
+        UpdateEnabled();
+    }
+
+    // gives the owner the next slot of the table the first time, call it while setting up rather than from the order path
+    void SetOwnerLimits(OwnerId ownerId, const OwnerRiskLimits &limits)
+    {
+        auto slot = slots_.find(ownerId);
+        if (slot == slots_.end())
+        {
+            if (owners_.size() == MaxOwners)
+                throw std::logic_error("Risk limits can only be set for 65535 owners");
+            owners_.emplace_back();
+            slot = slots_.emplace(ownerId, static_cast<std::uint16_t>(owners_.size())).first;
+        }
+        owners_[slot->second - 1].limits_ = limits;
+        UpdateEnabled();
+    }
+
+    // stores the owner's slot in the order before checking it
+    RiskCheck Check(Order &order, std::optional<Price> referencePrice)
+    {
+        if (!isEnabled_)
+            return RiskCheck::Passed;
+
+        if (!slots_.empty())
+        {
+            const auto slot = slots_.find(order.GetOwnerId());
+            order.SetRiskSlot(slot == slots_.end() ? 0 : slot->second);
+        }
+
+        const auto result = Evaluate(order, referencePrice);
+        rejections_[static_cast<std::size_t>(result)]++;
+        return result;
+    }
+
+    // these methods keep each owner's open quantity and position up to date through the order's slot, they are cheap no ops
+    // for orders without one
+    void OnOrderAdded(const Order &order)
+    {
+        if (auto *owner = FindOwner(order))
+            owner->openQuantity_ += order.GetRemainingQuantity();
+    }
+
+    void OnOrderRemoved(const Order &order)
+    {
+        if (auto *owner = FindOwner(order))
+            owner->ReduceOpenQuantity(order.GetRemainingQuantity());
+    }
+
+    void OnOrderFilled(const Order &order, Quantity quantity)
+    {
+        if (auto *owner = FindOwner(order))
+        {
+            owner->ReduceOpenQuantity(quantity);
+            owner->position_ += order.GetSide() == Side::Buy ? static_cast<std::int64_t>(quantity) : -static_cast<std::int64_t>(quantity);
+        }
+    }
+
+    // the Passed counter holds the number of orders checked and let through
+    const RiskRejections &GetRejections() const { return rejections_; }
+
+    static const char *GetName(RiskCheck check)
+    {
+        switch (check)
+        {
+        case RiskCheck::Passed:
+            return "Passed";
+        case RiskCheck::PriceBand:
+            return "PriceBand";
+        case RiskCheck::OrderQuantity:
+            return "OrderQuantity";
+        case RiskCheck::Notional:
+            return "Notional";
+        case RiskCheck::OpenQuantity:
+            return "OpenQuantity";
+        case RiskCheck::Position:
+            return "Position";
+        default:
+            return "Unknown";
+        }
+    }
+
+private:
+    struct OwnerRisk
+    {
+        OwnerRiskLimits limits_;
+        std::uint64_t openQuantity_{};
+        std::int64_t position_{};
+
+        // orders resting from before the owner was given limits were never counted, so this must not wrap
+        void ReduceOpenQuantity(Quantity quantity)
+        {
+            openQuantity_ -= std::min<std::uint64_t>(openQuantity_, quantity);
+        }
+    };
+
+    RiskCheck Evaluate(const Order &order, std::optional<Price> referencePrice) const
+    {
+        const Price price = order.GetPrice();
+        const Quantity quantity = order.GetRemainingQuantity();
+
+        if (limits_.priceBand_ != 0 && referencePrice)
+        {
+            const std::int64_t distance = static_cast<std::int64_t>(price) - *referencePrice;
+            if (distance > limits_.priceBand_ || distance < -static_cast<std::int64_t>(limits_.priceBand_))
+                return RiskCheck::PriceBand;
+        }
+
+        if (limits_.maxOrderQuantity_ != 0 && quantity > limits_.maxOrderQuantity_)
+            return RiskCheck::OrderQuantity;
+
+        if (limits_.maxNotional_ != 0)
+        {
+            const std::int64_t notional = static_cast<std::int64_t>(price) * quantity;
+            if (notional > limits_.maxNotional_ || notional < -limits_.maxNotional_)
+                return RiskCheck::Notional;
+        }
+
+        if (const auto *owner = FindOwner(order))
+        {
+            const auto &limits = owner->limits_;
+            if (limits.maxOpenQuantity_ != 0 && owner->openQuantity_ + quantity > limits.maxOpenQuantity_)
+                return RiskCheck::OpenQuantity;
+
+            if (limits.maxPosition_ != 0)
+            {
+                const std::int64_t position = owner->position_ + (order.GetSide() == Side::Buy ? static_cast<std::int64_t>(quantity) : -static_cast<std::int64_t>(quantity));
+                if (position > limits.maxPosition_ || position < -limits.maxPosition_)
+                    return RiskCheck::Position;
+            }
+        }
+
+        return RiskCheck::Passed;
+    }
+
+    OwnerRisk *FindOwner(const Order &order)
+    {
+        return order.GetRiskSlot() == 0 ? nullptr : &owners_[order.GetRiskSlot() - 1];
+    }
+
+    const OwnerRisk *FindOwner(const Order &order) const
+    {
+        return order.GetRiskSlot() == 0 ? nullptr : &owners_[order.GetRiskSlot() - 1];
+    }
+
+    void UpdateEnabled()
+    {
+        isEnabled_ = limits_.priceBand_ != 0 || limits_.maxOrderQuantity_ != 0 || limits_.maxNotional_ != 0 || !owners_.empty();
+    }
+
+    RiskLimits limits_;
+    // slot n is owners_[n - 1], slot 0 means no limits
+    std::unordered_map<OwnerId, std::uint16_t> slots_;
+    std::vector<OwnerRisk> owners_;
+    RiskRejections rejections_{};
+    bool isEnabled_{false};
+};
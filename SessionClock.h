@@ -0,0 +1,85 @@
+#pragma once
+
+#include <chrono>
+#include <ctime>
+
+// the time the book stamps its trades with and ends the trading session by. the wall clock reads system_clock, a simulated
+// clock only moves when it is advanced, from the timestamps of the commands being replayed, so a replay runs as fast as the
+// book can match and always gives the same result
+class SessionClock
+{
+public:
+    using Clock = std::chrono::system_clock;
+
+    // good for day orders expire at the close, this long after midnight
+    static constexpr std::chrono::hours DefaultSessionClose{16};
+
+    SessionClock() = default;
+
+    static SessionClock Simulated(Clock::time_point start, std::chrono::nanoseconds sessionClose = DefaultSessionClose)
+    {
+        SessionClock clock;
+        clock.isSimulated_ = true;
+        clock.now_ = start;
+        clock.sessionClose_ = sessionClose;
+        return clock;
+    }
+
+    bool IsSimulated() const { return isSimulated_; }
+
+    Clock::time_point Now() const { return isSimulated_ ? now_ : Clock::now(); }
+
+    // simulated time never goes back, a timestamp older than the current time leaves it where it is
+    void Advance(Clock::time_point now)
+    {
+        if (now > now_)
+            now_ = now;
+    }
+
+    // the first session close after time. simulated timestamps are taken as exchange time, so the close is counted from the
+    // midnight of the day they fall in without a time zone lookup. the wall clock closes at the local time of day
+    Clock::time_point GetNextSessionEnd(Clock::time_point time) const
+    {
+        using namespace std::chrono;
+
+        if (isSimulated_)
+        {
+            auto close = floor<days>(time) + duration_cast<Clock::duration>(sessionClose_);
+            if (close <= time)
+                close += days{1};
+            return close;
+        }
+
+        // convert the time to a time_t value, representing the seconds since the epoch
+        const auto time_c = Clock::to_time_t(time);
+        std::tm parts;
+        // breaks the time_t into a std::tm structure, which represents the data and time in year, month, day , hour, minute, second
+#ifdef _WIN32
+        localtime_s(&parts, &time_c);
+#else
+        localtime_r(&time_c, &parts);
+#endif
+
+        const auto sinceMidnight = hours{parts.tm_hour} + minutes{parts.tm_min} + seconds{parts.tm_sec};
+        if (sinceMidnight >= sessionClose_)
+        {
+            // already past the close today, set the target time for the close tomorrow
+            parts.tm_mday += 1;
+        }
+
+        // the exact time of the close
+        const auto close = duration_cast<seconds>(sessionClose_);
+        parts.tm_hour = static_cast<int>(close.count() / 3600);
+        parts.tm_min = static_cast<int>(close.count() / 60 % 60);
+        parts.tm_sec = static_cast<int>(close.count() % 60);
+        parts.tm_isdst = -1;
+
+        // convert the std::tm back to a time_point
+        return Clock::from_time_t(std::mktime(&parts));
+    }
+
+private:
+    bool isSimulated_{false};
+    Clock::time_point now_{};
+    std::chrono::nanoseconds sessionClose_{DefaultSessionClose};
+};
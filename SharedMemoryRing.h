@@ -0,0 +1,78 @@
+#pragma once
+
+#include <string>
+#include <system_error>
+#include <utility>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include "MarketDataRing.h"
+
+// maps a MarketDataRing into POSIX shared memory under a name like "/orderbook_md".
+// the publisher creates the ring and removes the name when it goes away, subscribers open it read only
+class SharedMemoryRing
+{
+public:
+    static SharedMemoryRing Create(const std::string &name, std::size_t capacity)
+    {
+        const auto size = MarketDataRing::GetRequiredSize(capacity);
+        auto memory = Map(name, O_CREAT | O_RDWR, PROT_READ | PROT_WRITE, size);
+        MarketDataRing::Initialize(memory, capacity);
+        return SharedMemoryRing{name, memory, size, true};
+    }
+
+    static SharedMemoryRing Open(const std::string &name)
+    {
+        // map the header first to learn the capacity, then map the whole ring
+        auto header = Map(name, O_RDONLY, PROT_READ, sizeof(MarketDataRing));
+        const auto size = MarketDataRing::GetRequiredSize(MarketDataRing::Attach(header).GetCapacity());
+        munmap(header, sizeof(MarketDataRing));
+
+        return SharedMemoryRing{name, Map(name, O_RDONLY, PROT_READ, size), size, false};
+    }
+
+    SharedMemoryRing(SharedMemoryRing &&other) noexcept : name_{std::move(other.name_)}, memory_{std::exchange(other.memory_, nullptr)}, size_{other.size_}, isOwner_{other.isOwner_} {}
+    SharedMemoryRing(const SharedMemoryRing &) = delete;
+    SharedMemoryRing &operator=(const SharedMemoryRing &) = delete;
+
+    ~SharedMemoryRing()
+    {
+        if (memory_ == nullptr)
+            return;
+        munmap(memory_, size_);
+        if (isOwner_)
+            shm_unlink(name_.c_str());
+    }
+
+    MarketDataRing &GetRing() { return *static_cast<MarketDataRing *>(memory_); }
+    const MarketDataRing &GetRing() const { return MarketDataRing::Attach(memory_); }
+
+private:
+    SharedMemoryRing(std::string name, void *memory, std::size_t size, bool isOwner) : name_{std::move(name)}, memory_{memory}, size_{size}, isOwner_{isOwner} {}
+
+    static void *Map(const std::string &name, int flags, int protection, std::size_t size)
+    {
+        int fd = shm_open(name.c_str(), flags, 0600);
+        if (fd < 0)
+            throw std::system_error(errno, std::generic_category(), "shm_open " + name);
+
+        if ((flags & O_CREAT) && ftruncate(fd, size) < 0)
+        {
+            close(fd);
+            throw std::system_error(errno, std::generic_category(), "ftruncate " + name);
+        }
+
+        auto memory = mmap(nullptr, size, protection, MAP_SHARED, fd, 0);
+        close(fd);
+        if (memory == MAP_FAILED)
+            throw std::system_error(errno, std::generic_category(), "mmap " + name);
+        return memory;
+    }
+
+    std::string name_;
+    void *memory_;
+    std::size_t size_;
+    bool isOwner_;
+};
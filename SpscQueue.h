@@ -0,0 +1,88 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <thread>
+
+// bounded single producer single consumer ring buffer. the producer only writes tail_ and the consumer only writes head_,
+// each on its own cache line, and each side caches the other's index so the shared line is only read when the cached value runs out.
+// either side can close the queue: the consumer drains what is left and then stops, the producer stops pushing
+template <typename T, std::size_t Capacity>
+class SpscQueue
+{
+    static_assert(Capacity > 1 && (Capacity & (Capacity - 1)) == 0, "SpscQueue capacity must be a power of two");
+
+public:
+    bool TryPush(const T &value)
+    {
+        const auto tail = tail_.load(std::memory_order_relaxed);
+        if (tail - cachedHead_ == Capacity)
+        {
+            cachedHead_ = head_.load(std::memory_order_acquire);
+            if (tail - cachedHead_ == Capacity)
+                return false;
+        }
+
+        buffer_[tail & Mask] = value;
+        tail_.store(tail + 1, std::memory_order_release);
+        return true;
+    }
+
+    bool TryPop(T &value)
+    {
+        const auto head = head_.load(std::memory_order_relaxed);
+        if (head == cachedTail_)
+        {
+            cachedTail_ = tail_.load(std::memory_order_acquire);
+            if (head == cachedTail_)
+                return false;
+        }
+
+        value = buffer_[head & Mask];
+        head_.store(head + 1, std::memory_order_release);
+        return true;
+    }
+
+    // blocks while the queue is full, returns false if the consumer closed the queue
+    bool Push(const T &value)
+    {
+        while (!TryPush(value))
+        {
+            if (IsClosed())
+                return false;
+            std::this_thread::yield();
+        }
+        return true;
+    }
+
+    // blocks while the queue is empty, returns false once the queue is closed and fully drained
+    bool Pop(T &value)
+    {
+        while (!TryPop(value))
+        {
+            if (IsClosed())
+                return TryPop(value);
+            std::this_thread::yield();
+        }
+        return true;
+    }
+
+    void Close() { closed_.store(true, std::memory_order_release); }
+    bool IsClosed() const { return closed_.load(std::memory_order_acquire); }
+
+private:
+    static constexpr std::size_t Mask = Capacity - 1;
+    static constexpr std::size_t CacheLineSize = 64;
+
+    // consumer side
+    alignas(CacheLineSize) std::atomic<std::size_t> head_{0};
+    std::size_t cachedTail_{0};
+
+    // producer side
+    alignas(CacheLineSize) std::atomic<std::size_t> tail_{0};
+    std::size_t cachedHead_{0};
+
+    alignas(CacheLineSize) std::atomic<bool> closed_{false};
+    alignas(CacheLineSize) std::array<T, Capacity> buffer_{};
+};
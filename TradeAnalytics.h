@@ -0,0 +1,175 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <vector>
+
+#include "Usings.h"
+#include "Side.h"
+
+// running trade statistics, each fill updates them in constant time so nothing ever has to rescan the trades
+struct TradeStatistics
+{
+    std::uint64_t volume_{};
+    std::uint64_t buyVolume_{}; // volume where the incoming order was a buy, the rest was sell initiated
+    std::int64_t notional_{};   // sum of price * quantity, for the vwap
+    std::uint64_t tradeCount_{};
+    Price open_{};
+    Price high_{};
+    Price low_{};
+    Price last_{};
+
+    void Add(Price price, Quantity quantity, Side aggressorSide)
+    {
+        if (tradeCount_ == 0)
+        {
+            open_ = high_ = low_ = price;
+        }
+        high_ = std::max(high_, price);
+        low_ = std::min(low_, price);
+        last_ = price;
+
+        volume_ += quantity;
+        notional_ += static_cast<std::int64_t>(price) * quantity;
+        tradeCount_++;
+        if (aggressorSide == Side::Buy)
+            buyVolume_ += quantity;
+    }
+
+    std::uint64_t GetSellVolume() const { return volume_ - buyVolume_; }
+    double GetVwap() const { return volume_ == 0 ? 0.0 : static_cast<double>(notional_) / volume_; }
+};
+
+// one closed interval of trading, sized to a single cache line
+struct TradeBar
+{
+    std::int64_t startTime_; // nanoseconds since the epoch
+    std::int64_t interval_;  // nanoseconds
+    TradeStatistics statistics_;
+};
+
+static_assert(sizeof(TradeBar) == 64, "TradeBar is meant to be a compact, cache line sized record");
+
+using TradeBars = std::vector<TradeBar>;
+
+class TradeAnalytics
+{
+public:
+    using Clock = std::chrono::system_clock;
+
+    // bars for every interval are kept at the same time, closed bars wait in a fixed ring until they are flushed
+    static constexpr std::array<std::chrono::nanoseconds, 2> BarIntervals{std::chrono::seconds{1}, std::chrono::minutes{1}};
+    static constexpr std::size_t MaxPendingBars = 1024;
+
+    TradeAnalytics()
+    {
+        for (std::size_t i = 0; i < BarIntervals.size(); i++)
+        {
+            series_[i].interval_ = BarIntervals[i].count();
+            series_[i].current_.interval_ = BarIntervals[i].count();
+            series_[i].pending_.resize(MaxPendingBars);
+        }
+    }
+
+    void OnTrade(Price price, Quantity quantity, Side aggressorSide, Clock::time_point time)
+    {
+        session_.Add(price, quantity, aggressorSide);
+
+        const auto now = ToNanoseconds(time);
+        for (auto &series : series_)
+        {
+            if (HasEnded(series, now))
+                Roll(series, now);
+            series.current_.statistics_.Add(price, quantity, aggressorSide);
+        }
+    }
+
+    // closes the bars whose interval is over by time, so the last bar before a quiet spell or the end of the session is closed
+    // without waiting for another trade
+    void CloseElapsedBars(Clock::time_point time)
+    {
+        const auto now = ToNanoseconds(time);
+        for (auto &series : series_)
+        {
+            if (series.current_.statistics_.tradeCount_ != 0 && HasEnded(series, now))
+                Roll(series, now);
+        }
+    }
+
+    const TradeStatistics &GetSession() const { return session_; }
+
+    // the statistics of the bar still being built at time for the given interval, empty if the interval is not tracked or the
+    // last bar with trades is already over
+    TradeStatistics GetCurrentBar(std::chrono::nanoseconds interval, Clock::time_point time) const
+    {
+        for (const auto &series : series_)
+        {
+            if (series.interval_ == interval.count())
+                return HasEnded(series, ToNanoseconds(time)) ? TradeStatistics{} : series.current_.statistics_;
+        }
+        return {};
+    }
+
+    // closes the bars that are over by time, then appends every closed bar, oldest first per interval, and forgets them. bars
+    // that overflowed the ring are counted as dropped
+    void FlushBars(TradeBars &bars, Clock::time_point time)
+    {
+        CloseElapsedBars(time);
+        for (auto &series : series_)
+        {
+            for (; series.pendingCount_ != 0; series.pendingCount_--)
+                bars.push_back(series.pending_[(series.pendingEnd_ - series.pendingCount_) % MaxPendingBars]);
+        }
+    }
+
+    std::uint64_t GetDroppedBarCount() const { return droppedBarCount_; }
+
+    // forgets the session statistics and every bar, closed bars that were not flushed included
+    void ResetSession()
+    {
+        session_ = {};
+        for (auto &series : series_)
+        {
+            series.current_ = TradeBar{0, series.interval_, {}};
+            series.pendingEnd_ = 0;
+            series.pendingCount_ = 0;
+        }
+        droppedBarCount_ = 0;
+    }
+
+private:
+    struct BarSeries
+    {
+        std::int64_t interval_{};
+        TradeBar current_{};
+        // sized once at construction, closing a bar never allocates
+        std::vector<TradeBar> pending_;
+        std::size_t pendingEnd_{};
+        std::size_t pendingCount_{};
+    };
+
+    static std::int64_t ToNanoseconds(Clock::time_point time) { return std::chrono::duration_cast<std::chrono::nanoseconds>(time.time_since_epoch()).count(); }
+    static bool HasEnded(const BarSeries &series, std::int64_t now) { return now >= series.current_.startTime_ + series.interval_; }
+
+    void Roll(BarSeries &series, std::int64_t now)
+    {
+        if (series.current_.statistics_.tradeCount_ != 0)
+        {
+            series.pending_[series.pendingEnd_ % MaxPendingBars] = series.current_;
+            series.pendingEnd_++;
+            if (series.pendingCount_ == MaxPendingBars)
+                droppedBarCount_++;
+            else
+                series.pendingCount_++;
+        }
+
+        // bars are aligned to whole intervals, so bars from different books line up
+        series.current_ = TradeBar{now - now % series.interval_, series.interval_, {}};
+    }
+
+    TradeStatistics session_;
+    std::array<BarSeries, BarIntervals.size()> series_;
+    std::uint64_t droppedBarCount_{};
+};
@@ -0,0 +1,136 @@
+#include "TradeTape.h"
+
+#include <stdexcept>
+
+#ifdef _WIN32
+#include <io.h>
+#else
+#include <unistd.h>
+#endif
+
+TradeTapeWriter::TradeTapeWriter(const std::filesystem::path &path, const TradeTapeOptions &options)
+    : options_{options}, ring_{std::make_unique<Ring>()}
+{
+    file_ = std::fopen(path.string().c_str(), "wb");
+    if (file_ == nullptr)
+        throw std::logic_error("Could not create trade tape " + path.string());
+
+    // the batches are already large, a stdio buffer would only add a copy
+    std::setvbuf(file_, nullptr, _IONBF, 0);
+
+    const TradeTapeHeader header{.recordSize_ = sizeof(TradeRecord)};
+    if (std::fwrite(&header, sizeof(header), 1, file_) != 1)
+    {
+        std::fclose(file_);
+        throw std::logic_error("Could not write trade tape header " + path.string());
+    }
+
+    batch_.reserve(options_.batchRecords_);
+    lastSync_ = std::chrono::steady_clock::now();
+    writerThread_ = std::thread{[this]
+                                { Run(); }};
+}
+
+TradeTapeWriter::~TradeTapeWriter()
+{
+    // a failed write has nowhere to go from a destructor, call Close to find out about it
+    if (writerThread_.joinable())
+    {
+        ring_->Close();
+        writerThread_.join();
+    }
+    if (file_ != nullptr)
+        std::fclose(file_);
+}
+
+void TradeTapeWriter::Append(const Trades &trades, std::chrono::system_clock::time_point time)
+{
+    if (trades.empty())
+        return;
+
+    // one timestamp for all the trades of one operation
+    const std::int64_t timestamp = std::chrono::duration_cast<std::chrono::nanoseconds>(time.time_since_epoch()).count();
+
+    for (const auto &trade : trades)
+    {
+        const TradeRecord record{sequence_++, timestamp, trade.GetBidTrade(), trade.GetAskTrade()};
+        if (!ring_->TryPush(record))
+        {
+            stallCount_++;
+            ring_->Push(record);
+        }
+    }
+}
+
+void TradeTapeWriter::Close()
+{
+    if (!writerThread_.joinable())
+        return;
+
+    // the writer drains the ring before it stops
+    ring_->Close();
+    writerThread_.join();
+
+    if (options_.syncPolicy_ != TapeSyncPolicy::None)
+        Sync();
+
+    if (std::fclose(file_) != 0)
+        failed_ = true;
+    file_ = nullptr;
+
+    if (failed_)
+        throw std::logic_error("Writing the trade tape failed");
+}
+
+void TradeTapeWriter::Run()
+{
+    TradeRecord record;
+    while (true)
+    {
+        while (batch_.size() < options_.batchRecords_ && ring_->TryPop(record))
+            batch_.push_back(record);
+
+        // a full batch goes out straight away, a partial one once the ring has run dry
+        if (!batch_.empty())
+        {
+            WriteBatch();
+            continue;
+        }
+
+        if (ring_->IsClosed())
+        {
+            // the producer may have pushed its last records just before closing
+            if (!ring_->TryPop(record))
+                break;
+            batch_.push_back(record);
+            continue;
+        }
+
+        std::this_thread::sleep_for(options_.idleWait_);
+    }
+}
+
+void TradeTapeWriter::WriteBatch()
+{
+    if (std::fwrite(batch_.data(), sizeof(TradeRecord), batch_.size(), file_) != batch_.size())
+        failed_ = true;
+    batch_.clear();
+
+    const auto now = std::chrono::steady_clock::now();
+    if (options_.syncPolicy_ == TapeSyncPolicy::EveryBatch || (options_.syncPolicy_ == TapeSyncPolicy::Interval && now - lastSync_ >= options_.syncInterval_))
+    {
+        Sync();
+        lastSync_ = now;
+    }
+}
+
+void TradeTapeWriter::Sync()
+{
+#ifdef _WIN32
+    if (_commit(_fileno(file_)) != 0)
+        failed_ = true;
+#else
+    if (fsync(fileno(file_)) != 0)
+        failed_ = true;
+#endif
+}
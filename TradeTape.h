@@ -0,0 +1,99 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <filesystem>
+#include <memory>
+#include <thread>
+#include <vector>
+
+#include "Trade.h"
+#include "SpscQueue.h"
+
+// a trade tape is a TradeTapeHeader followed by fixed size TradeRecords, in the byte order of the machine that wrote it
+
+struct TradeTapeHeader
+{
+    static constexpr std::uint32_t MagicNumber = 0x45504154; // "TAPE"
+    static constexpr std::uint32_t CurrentVersion = 1;
+
+    std::uint32_t magic_{MagicNumber};
+    std::uint32_t version_{CurrentVersion};
+    std::uint32_t recordSize_{};
+    std::uint32_t reserved_{};
+};
+
+struct TradeRecord
+{
+    std::uint64_t sequence_;
+    std::int64_t timestamp_; // nanoseconds since the epoch, the time the book made the trade
+    TradeInfo bidTrade_;
+    TradeInfo askTrade_;
+};
+
+static_assert(sizeof(TradeTapeHeader) == 16);
+static_assert(sizeof(TradeRecord) == 48, "TradeRecord is written to disk as is, its layout must not change");
+
+enum class TapeSyncPolicy : std::uint8_t
+{
+    // leave it to the operating system when the tape reaches the disk
+    None,
+    EveryBatch,
+    Interval,
+};
+
+struct TradeTapeOptions
+{
+    // records gathered into one write
+    std::size_t batchRecords_{4096};
+    TapeSyncPolicy syncPolicy_{TapeSyncPolicy::None};
+    std::chrono::milliseconds syncInterval_{1000};
+    // how long the writer sleeps when it finds the ring empty
+    std::chrono::microseconds idleWait_{200};
+};
+
+// the matching thread appends trades to a lock free ring and a background thread drains the ring into large sequential writes,
+// so the matching thread never waits on the disk. if the writer falls a whole ring behind the matching thread waits for it
+// rather than losing trades, GetStallCount says how often that happened
+class TradeTapeWriter
+{
+public:
+    explicit TradeTapeWriter(const std::filesystem::path &path, const TradeTapeOptions &options = {});
+    ~TradeTapeWriter();
+
+    TradeTapeWriter(const TradeTapeWriter &) = delete;
+    TradeTapeWriter &operator=(const TradeTapeWriter &) = delete;
+
+    // only ever call from one thread. time is the book's time for the operation that made the trades, so a replay on a
+    // simulated clock writes the same tape every time
+    void Append(const Trades &trades, std::chrono::system_clock::time_point time);
+
+    // writes out everything appended so far, syncs unless the policy is None, and stops the writer thread.
+    // throws if any write failed
+    void Close();
+
+    std::uint64_t GetRecordCount() const { return sequence_; }
+    std::uint64_t GetStallCount() const { return stallCount_; }
+
+private:
+    static constexpr std::size_t RingCapacity = 1 << 16;
+    using Ring = SpscQueue<TradeRecord, RingCapacity>;
+
+    void Run();
+    void WriteBatch();
+    void Sync();
+
+    TradeTapeOptions options_;
+    std::FILE *file_{nullptr};
+    // heap allocated, the ring is a few megabytes
+    std::unique_ptr<Ring> ring_;
+    std::vector<TradeRecord> batch_;
+    std::chrono::steady_clock::time_point lastSync_;
+
+    std::uint64_t sequence_{};
+    std::uint64_t stallCount_{};
+    std::atomic<bool> failed_{false};
+    std::thread writerThread_;
+};
@@ -1,8 +1,10 @@
 #pragma once
 
 #include <vector>
+#include <cstdint>
 
 using Price = std::int32_t;
 using Quantity = std::uint32_t;
 using OrderId = std::uint64_t;
+using OwnerId = std::uint32_t;
 using OrderIds = std::vector<OrderId>;
\ No newline at end of file
@@ -1,6 +1,60 @@
-#include "Orderbook.h"
+#include "OrderBook.h"
 #include "InputHandler.h"
+#include "SpscQueue.h"
+#include "TradeTape.h"
 #include <iostream>
+#include <thread>
+#include <optional>
+#include <exception>
+#include <string>
+
+// the driver runs as three stages, parsing, matching and reporting, each on its own thread and connected by bounded queues.
+// memory use stays constant however long the instruction file is, and throughput is set by the slowest stage
+using InformationQueue = SpscQueue<Information, 4096>;
+
+struct Report
+{
+    std::size_t instruction_;
+    std::size_t size_;
+    std::size_t bidLevels_;
+    std::size_t askLevels_;
+    std::size_t tradeCount_;
+    bool isSummary_;
+};
+
+using ReportQueue = SpscQueue<Report, 1024>;
+
+struct DriverOptions
+{
+    std::filesystem::path file_{"Instructions.txt"};
+    // report the orderbook every reportEvery_ instructions, 0 only reports the summary at the end
+    std::size_t reportEvery_{1};
+    // record every trade to this file, see tools/TapeReader.cpp
+    std::optional<std::filesystem::path> tape_;
+    bool syncTape_{false};
+};
+
+DriverOptions ParseOptions(int argc, char **argv)
+{
+    DriverOptions options;
+
+    for (int i = 1; i < argc; i++)
+    {
+        const std::string_view argument{argv[i]};
+        if (argument == "--summary-only")
+            options.reportEvery_ = 0;
+        else if (argument == "--report-every" && i + 1 < argc)
+            options.reportEvery_ = std::stoul(argv[++i]);
+        else if (argument == "--tape" && i + 1 < argc)
+            options.tape_ = argv[++i];
+        else if (argument == "--tape-sync")
+            options.syncTape_ = true;
+        else
+            options.file_ = argument;
+    }
+
+    return options;
+}
 
 std::shared_ptr<Order> GetOrder(const Information &information)
 {
@@ -21,35 +75,59 @@ OrderModify GetModifyOrder(const Information &information)
         information.quantity_);
 }
 
-int main()
+void ParseStage(const std::filesystem::path &file, InformationQueue &informations, std::optional<Result> &result, std::exception_ptr &error)
 {
-    std::cout << "STARTED\n";
-
-    // Parse with the input file containing instructions for the order book
     try
     {
-        std::filesystem::path file{"Instructions.txt"};
         InputHandler inputHandler;
-        const auto [informations, result] = inputHandler.GetInformationsAndResult(file);
-        size_t informationSize = informations.size();
-        std::cout << "PARSED INSTRUCTIONS\n";
+        result = inputHandler.StreamInformations(file, [&informations](const Information &information)
+                                                 {
+            if (!informations.Push(information))
+                throw std::logic_error("Matching stopped before all instructions were parsed"); });
+    }
+    catch (...)
+    {
+        error = std::current_exception();
+    }
+
+    // closing publishes the result to the other stages, they only read it once the queues are drained
+    informations.Close();
+}
+
+void MatchStage(InformationQueue &informations, ReportQueue &reports, std::size_t reportEvery, TradeTapeWriter *tape, std::exception_ptr &error)
+{
+    std::size_t instruction{};
+    std::size_t tradeCount{};
 
-        // Create the orderbook and execute those instructions in the file
+    try
+    {
         OrderBook orderBook;
+        auto MakeReport = [&](bool isSummary)
+        {
+            return Report{instruction, orderBook.Size(), orderBook.GetBidLevelCount(), orderBook.GetAskLevelCount(), tradeCount, isSummary};
+        };
 
-        for (int i = 0; i < informationSize; i++)
+        auto RecordTrades = [&](const Trades &trades)
+        {
+            tradeCount += trades.size();
+            if (tape != nullptr && !trades.empty())
+                tape->Append(trades, orderBook.GetTime());
+        };
+
+        bool isReplay{false};
+        Information information;
+        while (informations.Pop(information))
         {
-            auto information = informations.at(i);
             switch (information.type_)
             {
             case ActionType::Add:
             {
-                const auto &trades = orderBook.AddOrder(GetOrder(information));
+                RecordTrades(orderBook.AddOrder(GetOrder(information)));
             }
             break;
             case ActionType::Modify:
             {
-                const auto &trades = orderBook.ModifyOrder(GetModifyOrder(information));
+                RecordTrades(orderBook.ModifyOrder(GetModifyOrder(information)));
             }
             break;
             case ActionType::Cancel:
@@ -57,23 +135,130 @@ int main()
                 orderBook.CancelOrder(information.orderId_);
             }
             break;
+            case ActionType::Time:
+            {
+                // a file with timestamps is replayed on a simulated clock from its first one, good for day orders then expire
+                // at each session close in the file rather than at today's close
+                const SessionClock::Clock::time_point time{std::chrono::duration_cast<SessionClock::Clock::duration>(std::chrono::nanoseconds{information.timestamp_})};
+                if (!isReplay)
+                {
+                    orderBook.UseSimulatedClock(time);
+                    isReplay = true;
+                }
+                else
+                {
+                    orderBook.AdvanceTime(time);
+                }
+            }
+            break;
             default:
                 throw std::logic_error("Unsupported Action");
             }
 
-            std::cout << "\n=== Instruction " << i << " ===\n";
-            std::cout << "----- Orderbook Summary -----\n";
-            std::cout << "Orderbook Size: " << orderBook.Size() << "\n";
-            std::cout << "Number of Ask Orders: " << orderBook.GetOrderInfos().GetAsks().size() << "\n";
-            std::cout << "Number of Bid Orders: " << orderBook.GetOrderInfos().GetBids().size() << "\n";
-            std::cout << "-------------------------------\n";
+            if (reportEvery != 0 && (instruction + 1) % reportEvery == 0)
+                reports.Push(MakeReport(false));
+
+            instruction++;
         }
 
+        reports.Push(MakeReport(true));
+    }
+    catch (...)
+    {
+        error = std::current_exception();
+        // stop the parser, it would otherwise block on a full queue
+        informations.Close();
+    }
+
+    reports.Close();
+}
+
+void ReportStage(ReportQueue &reports, const std::optional<Result> &result)
+{
+    // output is built up in a buffer and written in large chunks instead of one stream insertion per field
+    constexpr std::size_t FlushSize = 64 * 1024;
+    std::string output;
+    output.reserve(FlushSize + 1024);
+
+    auto Flush = [&output]()
+    {
+        std::cout.write(output.data(), output.size());
+        output.clear();
+    };
+
+    Report report;
+    while (reports.Pop(report))
+    {
+        if (report.isSummary_)
+        {
+            output += "\n=== Summary ===\n";
+            output += "Instructions: " + std::to_string(report.instruction_) + "\n";
+            output += "Trades: " + std::to_string(report.tradeCount_) + "\n";
+        }
+        else
+        {
+            output += "\n=== Instruction " + std::to_string(report.instruction_) + " ===\n";
+        }
+        output += "----- Orderbook Summary -----\n";
+        output += "Orderbook Size: " + std::to_string(report.size_) + "\n";
+        output += "Number of Ask Orders: " + std::to_string(report.askLevels_) + "\n";
+        output += "Number of Bid Orders: " + std::to_string(report.bidLevels_) + "\n";
+        output += "-------------------------------\n";
+
+        if (output.size() >= FlushSize)
+            Flush();
+    }
+
+    // the result line is only known once parsing has finished, which the closed report queue guarantees
+    if (result.has_value())
+    {
+        output += "Expected Result: Size " + std::to_string(result->allCount_) + ", Bids " + std::to_string(result->bidCount_) + ", Asks " + std::to_string(result->askCount_) + "\n";
+    }
+
+    Flush();
+}
+
+int main(int argc, char **argv)
+{
+    std::ios::sync_with_stdio(false);
+    std::cout << "STARTED\n";
+
+    try
+    {
+        const auto options = ParseOptions(argc, argv);
+
+        InformationQueue informations;
+        ReportQueue reports;
+        std::optional<Result> result;
+        std::exception_ptr parseError, matchError;
+
+        std::unique_ptr<TradeTapeWriter> tape;
+        if (options.tape_)
+            tape = std::make_unique<TradeTapeWriter>(*options.tape_, TradeTapeOptions{.syncPolicy_ = options.syncTape_ ? TapeSyncPolicy::EveryBatch : TapeSyncPolicy::None});
+
+        std::thread parser{ParseStage, std::cref(options.file_), std::ref(informations), std::ref(result), std::ref(parseError)};
+        std::thread matcher{MatchStage, std::ref(informations), std::ref(reports), options.reportEvery_, tape.get(), std::ref(matchError)};
+
+        ReportStage(reports, result);
+
+        parser.join();
+        matcher.join();
+
+        if (tape)
+            tape->Close();
+
+        // a matching failure makes the parser fail too, so report the matching error first
+        if (matchError)
+            std::rethrow_exception(matchError);
+        if (parseError)
+            std::rethrow_exception(parseError);
+
         std::cout << "\nFINISHED";
         return 0;
     }
     catch (const std::logic_error &e)
     {
+        std::cout.flush();
         std::cerr << "Error: " << e.what() << std::endl;
         return 1;
     }
@@ -0,0 +1,97 @@
+#include "../OrderBook.h"
+#include "../AllocationTracker.h"
+#include "../BookDifferential.h"
+
+#include <iomanip>
+#include <iostream>
+
+#ifndef ORDERBOOK_TRACK_ALLOCATIONS
+#error "AllocationAudit must be built with -DORDERBOOK_TRACK_ALLOCATIONS"
+#endif
+
+// reports the heap allocations each book operation makes, then checks the zero allocation guarantee: after a warm up stream,
+// a second stream on the same book must not allocate anywhere except the Trades it returns, and a third one in execution report
+// mode must not allocate at all. exits with 1 if they do.
+// usage: AllocationAudit [max orders] [max levels] [instructions per stream]
+
+namespace
+{
+    // with a report, adds and modifies go through execution report mode and the report is cleared before each of them
+    void RunStream(OrderBook &orderBook, const Informations &informations, ExecutionReport *report = nullptr)
+    {
+        // add orders are built before they reach the book, their allocation belongs to the caller
+        std::vector<OrderPointer> orders;
+        orders.reserve(informations.size());
+        for (const auto &information : informations)
+            orders.push_back(information.type_ == ActionType::Add ? ToOrderPointer(information) : nullptr);
+
+        AllocationTracker::Reset();
+        for (std::size_t i = 0; i < informations.size(); i++)
+        {
+            if (report != nullptr)
+                report->Clear();
+
+            if (report != nullptr && informations[i].type_ == ActionType::Add)
+                orderBook.AddOrder(std::move(orders[i]), *report);
+            else if (report != nullptr && informations[i].type_ == ActionType::Modify)
+                orderBook.ModifyOrder(ToOrderModify(informations[i]), *report);
+            else if (informations[i].type_ == ActionType::Add)
+                orderBook.AddOrder(std::move(orders[i]));
+            else
+                ApplyInformation(orderBook, informations[i]);
+        }
+    }
+
+    void PrintStats(const char *title)
+    {
+        std::cout << title << "\n";
+        for (auto site : {AllocationSite::AddOrder, AllocationSite::CancelOrder, AllocationSite::ModifyOrder, AllocationSite::MatchTrades})
+        {
+            const auto &stats = AllocationTracker::GetStats(site);
+            std::cout << "  " << std::left << std::setw(12) << AllocationTracker::GetName(site)
+                      << " calls: " << std::setw(9) << stats.calls_
+                      << " allocations: " << std::setw(9) << stats.allocations_
+                      << " bytes: " << stats.bytes_ << "\n";
+        }
+    }
+}
+
+int main(int argc, char **argv)
+{
+    const OrderBookCapacity capacity{argc > 1 ? std::stoul(argv[1]) : 1 << 16, argc > 2 ? std::stoul(argv[2]) : 64};
+    const std::size_t count = argc > 3 ? std::stoul(argv[3]) : 200'000;
+
+    const auto warmUp = GenerateInformations(count, 1);
+    const auto measured = GenerateInformations(count, 2, 100, 5, count + 1);
+    const auto reported = GenerateInformations(count, 3, 100, 5, 2 * count + 1);
+
+    {
+        OrderBook orderBook;
+        RunStream(orderBook, warmUp);
+        PrintStats("default book, cold:");
+    }
+
+    OrderBook orderBook{capacity};
+    RunStream(orderBook, warmUp);
+    PrintStats("preconfigured book, warm up:");
+
+    // every stream starts by resetting the tracker, so the violations are added up after each strict one
+    std::size_t violations = 0;
+
+    AllocationTracker::SetStrict(true);
+    RunStream(orderBook, measured);
+    AllocationTracker::SetStrict(false);
+    violations += AllocationTracker::GetViolationCount();
+    PrintStats("preconfigured book, after warm up:");
+
+    // one incoming order can fill at most every order in the book
+    ExecutionReport report{1, capacity.maxOrders_};
+    AllocationTracker::SetStrict(true);
+    RunStream(orderBook, reported, &report);
+    AllocationTracker::SetStrict(false);
+    violations += AllocationTracker::GetViolationCount();
+    PrintStats("preconfigured book, execution reports:");
+
+    std::cout << (violations == 0 ? "PASS" : "FAIL") << ": " << violations << " hot path allocations after warm up\n";
+    return violations == 0 ? 0 : 1;
+}
@@ -0,0 +1,150 @@
+#include "../OrderBook.h"
+#include "../ReferenceOrderBook.h"
+#include "../BookDifferential.h"
+
+#include <cerrno>
+#include <cstring>
+#include <iostream>
+
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+static_assert(OrderBookBackend<OrderBook>);
+static_assert(OrderBookBackend<ProRataOrderBook>);
+static_assert(OrderBookBackend<HybridOrderBook>);
+static_assert(OrderBookBackend<ReferenceOrderBook>);
+
+// last level cache misses of this thread, read through perf_event_open. GetError() says why when the kernel or the machine
+// does not offer the counter, a virtual machine often has no hardware counters at all
+class CacheMissCounter
+{
+public:
+    CacheMissCounter()
+    {
+#ifdef __linux__
+        perf_event_attr attributes{};
+        attributes.size = sizeof(attributes);
+        attributes.type = PERF_TYPE_HARDWARE;
+        attributes.config = PERF_COUNT_HW_CACHE_MISSES;
+        attributes.disabled = 1;
+        attributes.exclude_kernel = 1;
+        attributes.exclude_hv = 1;
+        fd_ = static_cast<int>(syscall(SYS_perf_event_open, &attributes, 0, -1, -1, 0));
+        if (fd_ < 0)
+            error_ = std::strerror(errno);
+#else
+        error_ = "not supported on this platform";
+#endif
+    }
+    CacheMissCounter(const CacheMissCounter &) = delete;
+    CacheMissCounter &operator=(const CacheMissCounter &) = delete;
+
+    ~CacheMissCounter()
+    {
+#ifdef __linux__
+        if (fd_ >= 0)
+            close(fd_);
+#endif
+    }
+
+    bool IsAvailable() const { return fd_ >= 0; }
+    const std::string &GetError() const { return error_; }
+
+    void Start()
+    {
+#ifdef __linux__
+        ioctl(fd_, PERF_EVENT_IOC_RESET, 0);
+        ioctl(fd_, PERF_EVENT_IOC_ENABLE, 0);
+#endif
+    }
+
+    std::uint64_t Stop()
+    {
+        std::uint64_t count{};
+#ifdef __linux__
+        ioctl(fd_, PERF_EVENT_IOC_DISABLE, 0);
+        if (read(fd_, &count, sizeof(count)) != sizeof(count))
+            count = 0;
+#endif
+        return count;
+    }
+
+private:
+    int fd_{-1};
+    std::string error_;
+};
+
+// cache misses per matched order over one stream, a matched order being one resting order an incoming order traded with
+template <OrderBookBackend Book>
+double MeasureCacheMisses(CacheMissCounter &counter, const Informations &informations)
+{
+    std::vector<OrderPointer> orders;
+    orders.reserve(informations.size());
+    for (const auto &information : informations)
+        orders.push_back(information.type_ == ActionType::Add ? ToOrderPointer(information) : nullptr);
+
+    Book book;
+    std::size_t tradeCount{};
+
+    counter.Start();
+    for (std::size_t i = 0; i < informations.size(); i++)
+    {
+        const auto &information = informations[i];
+        if (information.type_ == ActionType::Add)
+            tradeCount += book.AddOrder(orders[i]).size();
+        else
+            tradeCount += ApplyInformation(book, information).size();
+    }
+    const auto misses = counter.Stop();
+
+    return tradeCount == 0 ? 0.0 : static_cast<double>(misses) / tradeCount;
+}
+
+// runs OrderBook against ReferenceOrderBook over many random streams, then times both backends and the pro rata and hybrid
+// matching policies on one large stream and counts their cache misses per matched order.
+// usage: BookCompare [seeds] [instructions per seed] [benchmark instructions]
+int main(int argc, char **argv)
+{
+    const std::uint32_t seeds = argc > 1 ? std::stoul(argv[1]) : 200;
+    const std::size_t count = argc > 2 ? std::stoul(argv[2]) : 2'000;
+    const std::size_t benchmarkCount = argc > 3 ? std::stoul(argv[3]) : 200'000;
+
+    for (std::uint32_t seed = 1; seed <= seeds; seed++)
+    {
+        const auto informations = GenerateInformations(count, seed);
+        if (const auto mismatch = RunDifferential<OrderBook, ReferenceOrderBook>(informations))
+        {
+            std::cerr << "MISMATCH seed " << seed << " instruction " << mismatch->instruction_ << ": " << mismatch->reason_ << "\n";
+            return 1;
+        }
+    }
+    std::cout << "differential: " << seeds << " seeds x " << count << " instructions matched\n";
+
+    const auto informations = GenerateInformations(benchmarkCount, 0);
+    const auto orderBookTime = TimeBackend<OrderBook>(informations);
+    const auto referenceTime = TimeBackend<ReferenceOrderBook>(informations);
+    const auto proRataTime = TimeBackend<ProRataOrderBook>(informations);
+    const auto hybridTime = TimeBackend<HybridOrderBook>(informations);
+
+    std::cout << "OrderBook:          " << orderBookTime.count() / benchmarkCount << " ns/instruction\n";
+    std::cout << "ReferenceOrderBook: " << referenceTime.count() / benchmarkCount << " ns/instruction\n";
+    std::cout << "ProRataOrderBook:   " << proRataTime.count() / benchmarkCount << " ns/instruction\n";
+    std::cout << "HybridOrderBook:    " << hybridTime.count() / benchmarkCount << " ns/instruction\n";
+
+    CacheMissCounter counter;
+    if (!counter.IsAvailable())
+    {
+        std::cout << "cache misses per matched order: unavailable, " << counter.GetError() << "\n";
+        return 0;
+    }
+
+    std::cout << "OrderBook:          " << MeasureCacheMisses<OrderBook>(counter, informations) << " cache misses/matched order\n";
+    std::cout << "ReferenceOrderBook: " << MeasureCacheMisses<ReferenceOrderBook>(counter, informations) << " cache misses/matched order\n";
+    std::cout << "ProRataOrderBook:   " << MeasureCacheMisses<ProRataOrderBook>(counter, informations) << " cache misses/matched order\n";
+    std::cout << "HybridOrderBook:    " << MeasureCacheMisses<HybridOrderBook>(counter, informations) << " cache misses/matched order\n";
+    return 0;
+}
@@ -0,0 +1,203 @@
+#include "../OrderBook.h"
+#include "../BookDifferential.h"
+#include "../ConsolidatedBook.h"
+
+#include <chrono>
+#include <iostream>
+#include <memory>
+#include <new>
+
+// drives several books with their own random streams, follows them with a ConsolidatedBook through in process market data rings,
+// and checks the merged depth against merging every book's GetOrderInfos. a second pass uses rings of a few slots polled only
+// now and then, so the books lap the view and every source is resynced from a snapshot many times. then times a consolidated
+// top of book and top 10 query against rebuilding them from the books. exits with 1 on a mismatch.
+// usage: ConsolidatedDepth [books] [instructions per book]
+
+namespace
+{
+    struct RingMemory
+    {
+        void operator()(void *memory) const { ::operator delete(memory, std::align_val_t{64}); }
+    };
+
+    std::unique_ptr<void, RingMemory> AllocateRing(std::size_t capacity)
+    {
+        auto *memory = ::operator new(MarketDataRing::GetRequiredSize(capacity), std::align_val_t{64});
+        MarketDataRing::Initialize(memory, capacity);
+        return std::unique_ptr<void, RingMemory>{memory};
+    }
+
+    // what the consolidated view replaces, merging every book's full depth on demand
+    std::pair<LevelInfos, LevelInfos> MergeSnapshots(const std::vector<std::unique_ptr<OrderBook>> &books)
+    {
+        std::map<Price, Quantity, std::greater<Price>> bids;
+        std::map<Price, Quantity, std::less<Price>> asks;
+        for (const auto &book : books)
+        {
+            const auto infos = book->GetOrderInfos();
+            for (const auto &level : infos.GetBids())
+                bids[level.price_] += level.quantity_;
+            for (const auto &level : infos.GetAsks())
+                asks[level.price_] += level.quantity_;
+        }
+
+        std::pair<LevelInfos, LevelInfos> merged;
+        for (const auto &[price, quantity] : bids)
+            merged.first.push_back(LevelInfo{price, quantity});
+        for (const auto &[price, quantity] : asks)
+            merged.second.push_back(LevelInfo{price, quantity});
+        return merged;
+    }
+
+    bool SameLevels(const LevelInfos &left, const LevelInfos &right)
+    {
+        if (left.size() != right.size())
+            return false;
+        for (std::size_t i = 0; i < left.size(); i++)
+        {
+            if (left[i].price_ != right[i].price_ || left[i].quantity_ != right[i].quantity_)
+                return false;
+        }
+        return true;
+    }
+
+    // books publishing into rings of their own and the consolidated view following them
+    struct Venues
+    {
+        std::vector<std::unique_ptr<void, RingMemory>> rings_;
+        std::vector<std::unique_ptr<MarketDataPublisher>> publishers_;
+        std::vector<std::unique_ptr<OrderBook>> books_;
+        std::vector<Informations> streams_;
+        ConsolidatedBook consolidated_;
+    };
+
+    void OpenVenues(Venues &venues, std::size_t bookCount, std::size_t count, std::size_t ringCapacity)
+    {
+        for (std::size_t i = 0; i < bookCount; i++)
+        {
+            venues.rings_.push_back(AllocateRing(ringCapacity));
+            auto &ring = *static_cast<MarketDataRing *>(venues.rings_.back().get());
+            venues.publishers_.push_back(std::make_unique<MarketDataPublisher>(ring));
+            venues.books_.push_back(std::make_unique<OrderBook>());
+            venues.books_.back()->SetMarketDataPublisher(venues.publishers_.back().get());
+            venues.consolidated_.AddSource(ring);
+            // the venues trade around slightly different prices so their depth overlaps without being identical
+            venues.streams_.push_back(GenerateInformations(count, static_cast<std::uint32_t>(i + 1), 100 + static_cast<Price>(i % 3), 8));
+        }
+    }
+
+    struct ReplayResult
+    {
+        bool matched_{true};
+        std::size_t events_{};
+        std::size_t resyncs_{};
+        std::chrono::nanoseconds pollTime_{};
+    };
+
+    // polls the view every pollInterval instructions, resyncs the sources whose ring lapped it, and compares the merged depth
+    // after every checkInterval instructions that ended in a poll
+    ReplayResult Replay(Venues &venues, std::size_t pollInterval, std::size_t checkInterval)
+    {
+        ReplayResult result;
+        auto &consolidated = venues.consolidated_;
+        const auto bookCount = venues.books_.size();
+        const auto count = venues.streams_.front().size();
+
+        for (std::size_t instruction = 0; instruction < count; instruction++)
+        {
+            for (std::size_t i = 0; i < bookCount; i++)
+                ApplyInformation(*venues.books_[i], venues.streams_[i][instruction]);
+
+            const bool isLast = instruction + 1 == count;
+            if (instruction % pollInterval != 0 && !isLast)
+                continue;
+
+            const auto start = std::chrono::steady_clock::now();
+            result.events_ += consolidated.Poll();
+            result.pollTime_ += std::chrono::steady_clock::now() - start;
+
+            for (std::size_t i = 0; i < bookCount; i++)
+            {
+                if (consolidated.NeedsResync(i))
+                {
+                    consolidated.Resync(i, *venues.books_[i]);
+                    result.resyncs_++;
+                }
+            }
+
+            if (instruction % checkInterval == 0 || isLast)
+            {
+                const auto [bids, asks] = MergeSnapshots(venues.books_);
+                if (!SameLevels(consolidated.GetBids(bids.size() + 1), bids) || !SameLevels(consolidated.GetAsks(asks.size() + 1), asks))
+                {
+                    std::cerr << "MISMATCH after instruction " << instruction << "\n";
+                    result.matched_ = false;
+                    return result;
+                }
+            }
+        }
+        return result;
+    }
+}
+
+int main(int argc, char **argv)
+{
+    const std::size_t bookCount = argc > 1 ? std::stoul(argv[1]) : 4;
+    const std::size_t count = argc > 2 ? std::stoul(argv[2]) : 50'000;
+    constexpr std::size_t RingCapacity = 1 << 16;
+    constexpr std::size_t SmallRingCapacity = 8;
+    constexpr std::size_t SmallRingPollInterval = 7;
+    constexpr std::size_t Depth = 10;
+
+    Venues venues;
+    OpenVenues(venues, bookCount, count, RingCapacity);
+    const auto result = Replay(venues, 1, 1000);
+    if (!result.matched_)
+        return 1;
+    std::cout << "consolidated " << bookCount << " books x " << count << " instructions matched, "
+              << result.pollTime_.count() / std::max<std::size_t>(result.events_, 1) << " ns per market data event\n";
+
+    // each instruction publishes a few events, so a ring of 8 slots read every 7 instructions is lapped almost every time
+    {
+        Venues lapped;
+        OpenVenues(lapped, bookCount, count, SmallRingCapacity);
+        const auto lappedResult = Replay(lapped, SmallRingPollInterval, SmallRingPollInterval);
+        if (!lappedResult.matched_)
+            return 1;
+        if (lappedResult.resyncs_ == 0)
+        {
+            std::cerr << "MISMATCH no source needed a resync with " << SmallRingCapacity << " slot rings\n";
+            return 1;
+        }
+        std::cout << "consolidated " << bookCount << " books x " << count << " instructions matched with " << SmallRingCapacity << " slot rings, "
+                  << lappedResult.resyncs_ << " resyncs\n";
+    }
+
+    const auto &consolidated = venues.consolidated_;
+    const auto &books = venues.books_;
+    constexpr std::size_t Queries = 10'000;
+    std::size_t sink = 0;
+
+    auto start = std::chrono::steady_clock::now();
+    for (std::size_t i = 0; i < Queries; i++)
+    {
+        sink += consolidated.GetBestBid().has_value() + consolidated.GetBestAsk().has_value();
+        sink += consolidated.GetBids(Depth).size() + consolidated.GetAsks(Depth).size();
+    }
+    const auto consolidatedTime = std::chrono::steady_clock::now() - start;
+
+    start = std::chrono::steady_clock::now();
+    for (std::size_t i = 0; i < Queries; i++)
+    {
+        const auto [bids, asks] = MergeSnapshots(books);
+        sink += std::min(bids.size(), Depth) + std::min(asks.size(), Depth);
+    }
+    const auto mergeTime = std::chrono::steady_clock::now() - start;
+
+    volatile std::size_t observed = sink;
+    (void)observed;
+
+    std::cout << "top of book and " << Depth << " levels, consolidated: " << std::chrono::duration_cast<std::chrono::nanoseconds>(consolidatedTime).count() / Queries << " ns\n";
+    std::cout << "top of book and " << Depth << " levels, merging snapshots: " << std::chrono::duration_cast<std::chrono::nanoseconds>(mergeTime).count() / Queries << " ns\n";
+    return 0;
+}
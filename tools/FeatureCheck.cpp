@@ -0,0 +1,1342 @@
+#include "../OrderBook.h"
+#include "../ReferenceOrderBook.h"
+#include "../BookDifferential.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <limits>
+#include <map>
+#include <random>
+#include <span>
+#include <unordered_map>
+
+// checks the parts of OrderBook the differential stream in BookCompare does not reach. each check drives the book over random
+// command streams next to ReferenceOrderBook, or next to a brute force model where the reference has no such feature, and the
+// tool exits with 1 at the first mismatch.
+// usage: FeatureCheck [seeds] [instructions per seed]
+
+namespace
+{
+    using CheckResult = std::optional<DifferentialMismatch>;
+
+    // every add asks for a handle and every cancel and modify goes through it, the reference gets the same commands by order id.
+    // handles of orders that left the book are kept, and cancelling or modifying through one must not reach the order that
+    // took over its slot
+    CheckResult CheckHandles(std::uint32_t seed, std::size_t count)
+    {
+        const auto informations = GenerateInformations(count, seed);
+        OrderBook book;
+        ReferenceOrderBook reference;
+        std::unordered_map<OrderId, OrderHandle> handles;
+        std::vector<OrderHandle> staleHandles;
+        OrderId lastOrderId{};
+
+        for (std::size_t i = 0; i < informations.size(); i++)
+        {
+            const auto &information = informations[i];
+            const auto handle = handles.find(information.orderId_);
+            Trades trades, expected;
+
+            switch (information.type_)
+            {
+            case ActionType::Add:
+            {
+                OrderHandle added;
+                trades = book.AddOrder(ToOrderPointer(information), added);
+                expected = reference.AddOrder(ToOrderPointer(information));
+                if (added.IsValid() != reference.Contains(information.orderId_))
+                    return DifferentialMismatch{i, "handle given out for an order that does not rest, or not for one that does"};
+                if (added.IsValid())
+                    handles[information.orderId_] = added;
+                lastOrderId = information.orderId_;
+            }
+            break;
+            case ActionType::Modify:
+            {
+                // a modify naming another order must leave the handle as it is
+                if (handle != handles.end() && (!book.ModifyOrder(handle->second, OrderModify(information.orderId_ + 1, information.side_, information.price_, information.quantity_)).empty() || !handle->second.IsValid()))
+                    return DifferentialMismatch{i, "modify naming another order changed the handle"};
+                if (handle != handles.end())
+                    trades = book.ModifyOrder(handle->second, ToOrderModify(information));
+                expected = reference.ModifyOrder(ToOrderModify(information));
+            }
+            break;
+            case ActionType::Cancel:
+            {
+                const bool isResting = reference.Contains(information.orderId_);
+                if (handle != handles.end() && book.CancelOrder(handle->second) != isResting)
+                    return DifferentialMismatch{i, "handle cancel result differs from the reference"};
+                reference.CancelOrder(information.orderId_);
+            }
+            break;
+            default:
+                throw std::logic_error("Unsupported Action");
+            }
+
+            if (auto reason = CompareTrades(trades, expected))
+                return DifferentialMismatch{i, *reason};
+            if (auto reason = CompareBooks(book, reference))
+                return DifferentialMismatch{i, *reason};
+
+            // a handle goes stale as soon as its order is filled, cancelled or replaced
+            for (auto entry = handles.begin(); entry != handles.end();)
+            {
+                if (reference.Contains(entry->first) && entry->second.IsValid())
+                {
+                    ++entry;
+                    continue;
+                }
+                staleHandles.push_back(entry->second);
+                entry = handles.erase(entry);
+            }
+
+            // one stale handle per instruction, aimed at the newest order in case that order reuses its slot
+            if (staleHandles.empty())
+                continue;
+            auto stale = staleHandles[i % staleHandles.size()];
+            if (book.CancelOrder(stale))
+                return DifferentialMismatch{i, "stale handle cancelled an order"};
+            if (!book.ModifyOrder(stale, OrderModify(lastOrderId, Side::Buy, 1, 1)).empty() || stale.IsValid())
+                return DifferentialMismatch{i, "stale handle modified an order"};
+            if (auto reason = CompareBooks(book, reference))
+                return DifferentialMismatch{i, "after a stale handle, " + *reason};
+        }
+
+        return std::nullopt;
+    }
+
+    // after every instruction the queue position of each resting order is compared with the reference, which counts the orders
+    // ahead of it in its level. an order that is not resting must not have a position
+    CheckResult CheckQueuePositions(std::uint32_t seed, std::size_t count)
+    {
+        const auto informations = GenerateInformations(count, seed);
+        OrderBook book;
+        ReferenceOrderBook reference;
+        std::vector<OrderId> resting;
+
+        for (std::size_t i = 0; i < informations.size(); i++)
+        {
+            const auto &information = informations[i];
+            if (auto reason = CompareTrades(ApplyInformation(book, information), ApplyInformation(reference, information)))
+                return DifferentialMismatch{i, *reason};
+
+            if (information.type_ == ActionType::Add)
+                resting.push_back(information.orderId_);
+            std::erase_if(resting, [&](OrderId orderId)
+                          { return !reference.Contains(orderId); });
+
+            for (const auto orderId : resting)
+            {
+                const auto position = book.GetQueuePosition(orderId);
+                const auto expected = reference.GetQueuePosition(orderId);
+                if (!position || position->ordersAhead_ != expected->ordersAhead_ || position->quantityAhead_ != expected->quantityAhead_)
+                    return DifferentialMismatch{i, "queue position of order " + std::to_string(orderId) + " differs"};
+            }
+            if (!reference.Contains(information.orderId_) && book.GetQueuePosition(information.orderId_))
+                return DifferentialMismatch{i, "order " + std::to_string(information.orderId_) + " has a queue position but is not resting"};
+        }
+
+        return std::nullopt;
+    }
+
+    // where the model last saw an order go in, a modify moves it
+    struct OwnedOrder
+    {
+        OwnerId ownerId_;
+        Side side_;
+        Price price_;
+    };
+
+    // orders are spread over a few owners, market orders have none since their resting price is only known to the book. every
+    // fifth instruction cancels one owner's orders, through a random side and price filter or all of them, and the ids the book
+    // returns must be exactly the resting orders a scan of every order finds for that owner and filter. the reference cancels
+    // those and the rest of the book must still match it
+    CheckResult CheckMassCancels(std::uint32_t seed, std::size_t count)
+    {
+        constexpr OwnerId OwnerCount = 4;
+
+        const auto informations = GenerateInformations(count, seed);
+        std::mt19937 generator{seed};
+        const auto Roll = [&](int outOf)
+        { return std::uniform_int_distribution<int>{0, outOf - 1}(generator); };
+
+        OrderBook book;
+        ReferenceOrderBook reference;
+        std::unordered_map<OrderId, OwnedOrder> orders;
+
+        for (std::size_t i = 0; i < informations.size(); i++)
+        {
+            const auto &information = informations[i];
+            Trades trades, expected;
+
+            if (information.type_ == ActionType::Add)
+            {
+                const OwnerId ownerId = information.orderType_ == OrderType::Market ? Constants::NoOwner : 1 + Roll(OwnerCount);
+                trades = book.AddOrder(std::make_shared<Order>(information.orderType_, information.orderId_, information.side_, information.price_, information.quantity_, ownerId));
+                expected = reference.AddOrder(ToOrderPointer(information));
+                orders[information.orderId_] = OwnedOrder{ownerId, information.side_, information.price_};
+            }
+            else if (information.type_ == ActionType::Modify)
+            {
+                // the replacement keeps the owner
+                const auto order = orders.find(information.orderId_);
+                if (order != orders.end() && reference.Contains(information.orderId_))
+                {
+                    order->second.side_ = information.side_;
+                    order->second.price_ = information.price_;
+                }
+                trades = book.ModifyOrder(ToOrderModify(information));
+                expected = reference.ModifyOrder(ToOrderModify(information));
+            }
+            else
+            {
+                book.CancelOrder(information.orderId_);
+                reference.CancelOrder(information.orderId_);
+            }
+
+            if (auto reason = CompareTrades(trades, expected))
+                return DifferentialMismatch{i, *reason};
+            if (i % 5 != 0)
+                continue;
+
+            // owner OwnerCount + 1 never has orders
+            const OwnerId ownerId = 1 + Roll(OwnerCount + 1);
+            MassCancelFilter filter;
+            if (Roll(3) == 0)
+                filter.side_ = Roll(2) == 0 ? Side::Buy : Side::Sell;
+            if (Roll(3) == 0)
+                filter.minPrice_ = 95 + Roll(11);
+            if (Roll(3) == 0)
+                filter.maxPrice_ = 95 + Roll(11);
+            const bool isFiltered = filter.side_ || filter.minPrice_ || filter.maxPrice_;
+
+            OrderIds cancelled = isFiltered || Roll(2) == 0 ? book.MassCancel(ownerId, filter) : book.CancelAllForOwner(ownerId);
+            std::sort(cancelled.begin(), cancelled.end());
+
+            OrderIds scanned;
+            for (const auto &[orderId, order] : orders)
+            {
+                const bool isMatch = (!filter.side_ || order.side_ == *filter.side_) && (!filter.minPrice_ || order.price_ >= *filter.minPrice_) && (!filter.maxPrice_ || order.price_ <= *filter.maxPrice_);
+                if (order.ownerId_ == ownerId && isMatch && reference.Contains(orderId))
+                    scanned.push_back(orderId);
+            }
+            std::sort(scanned.begin(), scanned.end());
+
+            if (cancelled != scanned)
+                return DifferentialMismatch{i, "mass cancel of owner " + std::to_string(ownerId) + " returned " + std::to_string(cancelled.size()) + " orders, a scan finds " + std::to_string(scanned.size())};
+            for (const auto orderId : scanned)
+                reference.CancelOrder(orderId);
+            if (auto reason = CompareBooks(book, reference))
+                return DifferentialMismatch{i, "after a mass cancel, " + *reason};
+        }
+
+        return std::nullopt;
+    }
+
+    // a quote the model knows to rest in the book
+    struct QuoteState
+    {
+        Side side_;
+        Price price_;
+        OrderId orderId_;
+        Quantity remaining_;
+    };
+
+    // what a new quote set should do to a level the owner has resting
+    enum class QuoteDiff
+    {
+        Keep,
+        Smaller,
+        Larger,
+        Cancel,
+    };
+
+    struct QuoteExpectation
+    {
+        QuoteState state_;
+        QuoteDiff diff_;
+        Quantity quantity_;
+        std::optional<QueuePosition> before_;
+        // sent with the level, the book must ignore it since the level already rests
+        OrderId ignoredOrderId_;
+    };
+
+    std::optional<Quantity> GetLevelQuantity(const OrderbookLevelInfos &infos, Side side, Price price)
+    {
+        for (const auto &level : side == Side::Buy ? infos.GetBids() : infos.GetAsks())
+        {
+            if (level.price_ == price)
+                return level.quantity_;
+        }
+        return std::nullopt;
+    }
+
+    // two owners requote every third instruction of a random stream from other traders. each new set keeps, shrinks, grows, zeroes
+    // or leaves out the levels the owner has resting and adds new ones, and every level is checked against what the diff should
+    // do to it: kept and smaller levels keep their order and the orders ahead of it, larger ones go to the back of their level,
+    // the rest are cancelled, and a new order id sent for a level that already rests is never entered. a set with a duplicate
+    // level or bids at or above its asks must leave the book untouched. last, a quote is grown next to an open quantity limit
+    CheckResult CheckMassQuotes(std::uint32_t seed, std::size_t count)
+    {
+        constexpr OwnerId QuoteOwnerCount = 2;
+        constexpr OrderId FirstQuoteId = 1'000'000'000;
+
+        const auto informations = GenerateInformations(count, seed);
+        std::mt19937 generator{seed};
+        const auto Roll = [&](int outOf)
+        { return std::uniform_int_distribution<int>{0, outOf - 1}(generator); };
+
+        OrderBook book;
+        std::vector<QuoteState> owners[QuoteOwnerCount];
+        OrderId nextQuoteId = FirstQuoteId;
+
+        // fills of resting quotes come back in the trades of whoever traded with them
+        const auto ApplyFills = [&](const Trades &trades)
+        {
+            for (auto &states : owners)
+            {
+                for (auto &state : states)
+                {
+                    for (const auto &trade : trades)
+                    {
+                        const auto &info = state.side_ == Side::Buy ? trade.GetBidTrade() : trade.GetAskTrade();
+                        if (info.orderId_ == state.orderId_)
+                            state.remaining_ -= info.quantity_;
+                    }
+                }
+                std::erase_if(states, [](const QuoteState &state)
+                              { return state.remaining_ == 0; });
+            }
+        };
+
+        const auto GetTradedQuantity = [](const Trades &trades, OrderId orderId)
+        {
+            Quantity quantity{};
+            for (const auto &trade : trades)
+            {
+                if (trade.GetBidTrade().orderId_ == orderId)
+                    quantity += trade.GetBidTrade().quantity_;
+                if (trade.GetAskTrade().orderId_ == orderId)
+                    quantity += trade.GetAskTrade().quantity_;
+            }
+            return quantity;
+        };
+
+        for (std::size_t i = 0; i < informations.size(); i++)
+        {
+            ApplyFills(ApplyInformation(book, informations[i]));
+            if (i % 3 != 0)
+                continue;
+
+            const OwnerId ownerId = 1 + (i / 3) % QuoteOwnerCount;
+            auto &states = owners[ownerId - 1];
+
+            // bids stay at or below 100 and asks above it, so the owner's own quotes never cross each other
+            Quotes quotes;
+            std::vector<QuoteExpectation> expectations;
+            for (const auto &state : states)
+            {
+                const auto roll = Roll(100);
+                const OrderId ignoredOrderId = nextQuoteId++;
+                QuoteExpectation expectation{state, QuoteDiff::Keep, state.remaining_, book.GetQueuePosition(state.orderId_), ignoredOrderId};
+                if (!expectation.before_)
+                    return DifferentialMismatch{i, "quote " + std::to_string(state.orderId_) + " is not resting"};
+
+                // a level left out of the set is cancelled like one sent with no quantity
+                if (roll < 20)
+                {
+                    expectation.diff_ = QuoteDiff::Cancel;
+                    expectation.quantity_ = 0;
+                    expectations.push_back(expectation);
+                    continue;
+                }
+                if (roll < 30)
+                {
+                    expectation.diff_ = QuoteDiff::Cancel;
+                    expectation.quantity_ = 0;
+                }
+                else if (roll < 45 && state.remaining_ > 1)
+                {
+                    expectation.diff_ = QuoteDiff::Smaller;
+                    expectation.quantity_ = 1 + Roll(state.remaining_ - 1);
+                }
+                else if (roll < 60)
+                {
+                    expectation.diff_ = QuoteDiff::Larger;
+                    expectation.quantity_ = state.remaining_ + 1 + Roll(10);
+                }
+
+                quotes.push_back(Quote{state.side_, state.price_, expectation.quantity_, ignoredOrderId});
+                expectations.push_back(expectation);
+            }
+
+            std::vector<QuoteState> added;
+            for (int count = Roll(3); count >= 0; count--)
+            {
+                const Side side = Roll(2) == 0 ? Side::Buy : Side::Sell;
+                const Price price = side == Side::Buy ? 96 + Roll(5) : 101 + Roll(5);
+                const auto isTaken = [&](const QuoteState &state)
+                { return state.side_ == side && state.price_ == price; };
+                if (std::any_of(states.begin(), states.end(), isTaken) || std::any_of(added.begin(), added.end(), isTaken))
+                    continue;
+
+                added.push_back(QuoteState{side, price, nextQuoteId++, static_cast<Quantity>(1 + Roll(20))});
+                quotes.push_back(Quote{side, price, added.back().remaining_, added.back().orderId_});
+            }
+
+            const bool isInvalid = Roll(20) == 0;
+            if (isInvalid && !quotes.empty() && Roll(2) == 0)
+                quotes.push_back(quotes.front());
+            else if (isInvalid)
+            {
+                quotes.push_back(Quote{Side::Buy, 103, 5, nextQuoteId++});
+                quotes.push_back(Quote{Side::Sell, 102, 5, nextQuoteId++});
+            }
+
+            const auto infosBefore = book.GetOrderInfos();
+            const auto sizeBefore = book.Size();
+            const auto trades = book.MassQuote(ownerId, quotes);
+
+            if (isInvalid)
+            {
+                const auto infos = book.GetOrderInfos();
+                if (!trades.empty() || book.Size() != sizeBefore || CompareLevels(infos.GetBids(), infosBefore.GetBids(), "bid") || CompareLevels(infos.GetAsks(), infosBefore.GetAsks(), "ask"))
+                    return DifferentialMismatch{i, "an invalid quote set changed the book"};
+                for (const auto &expectation : expectations)
+                {
+                    const auto position = book.GetQueuePosition(expectation.state_.orderId_);
+                    if (!position || position->ordersAhead_ != expectation.before_->ordersAhead_)
+                        return DifferentialMismatch{i, "an invalid quote set moved quote " + std::to_string(expectation.state_.orderId_)};
+                }
+                continue;
+            }
+
+            // the owner's quotes never cross each other, so the levels that were already resting cannot have traded
+            const auto infos = book.GetOrderInfos();
+            std::vector<QuoteState> next;
+            for (const auto &expectation : expectations)
+            {
+                const auto &state = expectation.state_;
+                const auto position = book.GetQueuePosition(state.orderId_);
+                const auto name = "quote " + std::to_string(state.orderId_);
+                if (book.GetQueuePosition(expectation.ignoredOrderId_) || GetTradedQuantity(trades, expectation.ignoredOrderId_) != 0)
+                    return DifferentialMismatch{i, name + " was entered again under a new order id"};
+                if (GetTradedQuantity(trades, state.orderId_) != 0)
+                    return DifferentialMismatch{i, name + " traded while its owner requoted"};
+
+                if (expectation.diff_ == QuoteDiff::Cancel)
+                {
+                    if (position)
+                        return DifferentialMismatch{i, name + " left out of the set is still resting"};
+                    continue;
+                }
+                if (!position)
+                    return DifferentialMismatch{i, name + " kept in the set is gone"};
+
+                if (expectation.diff_ == QuoteDiff::Larger)
+                {
+                    if (position->quantityAhead_ + expectation.quantity_ != GetLevelQuantity(infos, state.side_, state.price_))
+                        return DifferentialMismatch{i, name + " grew but is not at the back of its level"};
+                }
+                else if (position->ordersAhead_ != expectation.before_->ordersAhead_ || position->quantityAhead_ != expectation.before_->quantityAhead_)
+                    return DifferentialMismatch{i, name + " lost its queue priority"};
+
+                next.push_back(QuoteState{state.side_, state.price_, state.orderId_, expectation.quantity_});
+            }
+
+            for (auto state : added)
+            {
+                const auto traded = GetTradedQuantity(trades, state.orderId_);
+                if (traded > state.remaining_ || book.GetQueuePosition(state.orderId_).has_value() != (traded < state.remaining_))
+                    return DifferentialMismatch{i, "new quote " + std::to_string(state.orderId_) + " traded " + std::to_string(traded) + " of " + std::to_string(state.remaining_)};
+                state.remaining_ -= traded;
+                if (state.remaining_ != 0)
+                    next.push_back(state);
+            }
+            states = std::move(next);
+
+            // the other owner's quotes may have traded with the new ones
+            auto &others = owners[ownerId % QuoteOwnerCount];
+            for (auto &state : others)
+                state.remaining_ -= GetTradedQuantity(trades, state.orderId_);
+            std::erase_if(others, [](const QuoteState &state)
+                          { return state.remaining_ == 0; });
+
+            if (!infos.GetBids().empty() && !infos.GetAsks().empty() && infos.GetBids().front().price_ >= infos.GetAsks().front().price_)
+                return DifferentialMismatch{i, "book crossed after a mass quote"};
+        }
+
+        // an owner with an open quantity limit grows a bid up to what the limit leaves beside its ask, which cancelling and
+        // adding the bid would allow, then asks for one lot more and must keep the size it had
+        constexpr Quantity OpenQuantityLimit = 100;
+        OrderBook limited;
+        limited.SetOwnerRiskLimits(1, OwnerRiskLimits{OpenQuantityLimit, 0});
+        const Quantity ask = 1 + Roll(20);
+        const Quantity bid = 1 + Roll(static_cast<int>(OpenQuantityLimit - ask - 1));
+        const Quantity grown = bid + 1 + Roll(static_cast<int>(OpenQuantityLimit - ask - bid));
+        for (const auto size : {bid, grown, static_cast<Quantity>(OpenQuantityLimit - ask + 1)})
+        {
+            limited.MassQuote(1, Quotes{Quote{Side::Buy, 99, size, nextQuoteId++}, Quote{Side::Sell, 101, ask, nextQuoteId++}});
+            const auto infos = limited.GetOrderInfos();
+            if (GetLevelQuantity(infos, Side::Buy, 99) != std::min(size, grown) || GetLevelQuantity(infos, Side::Sell, 101) != ask)
+                return DifferentialMismatch{count, "a bid of " + std::to_string(size) + " beside an ask of " + std::to_string(ask) + " was sized against an open quantity limit of " + std::to_string(OpenQuantityLimit) + " wrongly"};
+        }
+
+        return std::nullopt;
+    }
+
+    struct PegState
+    {
+        PegReference reference_;
+        Price offset_;
+        // the book reprices the order it was given, so the tool reads the peg's price straight from it
+        OrderPointer order_;
+        // where the model expects the peg, set once the book has accepted it
+        Price price_{};
+    };
+
+    // the price a peg should rest at, worked out from the best bid and ask among the orders that are not pegged
+    std::optional<Price> GetExpectedPegPrice(const PegState &peg, std::optional<Price> bestBid, std::optional<Price> bestAsk)
+    {
+        const bool isBuy = peg.order_->GetSide() == Side::Buy;
+        if (peg.reference_ == PegReference::BestBid)
+            return bestBid ? std::optional<Price>{*bestBid + peg.offset_} : std::nullopt;
+        if (peg.reference_ == PegReference::BestAsk)
+            return bestAsk ? std::optional<Price>{*bestAsk + peg.offset_} : std::nullopt;
+        if (!bestBid || !bestAsk)
+            return std::nullopt;
+        const Price sum = *bestBid + *bestAsk;
+        return (isBuy ? sum / 2 : (sum + 1) / 2) + peg.offset_;
+    }
+
+    // pegs are entered into a random stream from other traders and now and then cancelled. after every instruction each resting
+    // peg must sit at its reference price, taken from the orders that are not pegged, or where it was if its reference is gone,
+    // and the book must not be crossed. an aggressive peg or one without a reference price is rejected, and the only trades
+    // repricing makes on its own are between midpoint pegs
+    template <typename Book>
+    CheckResult CheckPegs(std::uint32_t seed, std::size_t count)
+    {
+        constexpr OrderId FirstPegId = 1'000'000'000;
+
+        const auto informations = GenerateInformations(count, seed);
+        std::mt19937 generator{seed};
+        const auto Roll = [&](int outOf)
+        { return std::uniform_int_distribution<int>{0, outOf - 1}(generator); };
+
+        Book book;
+        // side and price of every resting order that is not pegged
+        std::unordered_map<OrderId, std::pair<Side, Price>> unpegged;
+        std::unordered_map<OrderId, PegState> pegs;
+        OrderId nextPegId = FirstPegId;
+
+        const auto GetUnpeggedBest = [&](Side side)
+        {
+            std::optional<Price> best;
+            for (const auto &[orderId, order] : unpegged)
+            {
+                if (order.first == side)
+                    best = !best ? order.second : side == Side::Buy ? std::max(*best, order.second) : std::min(*best, order.second);
+            }
+            return best;
+        };
+
+        const auto CheckRepricingTrades = [&](const Trades &trades) -> std::optional<std::string>
+        {
+            for (const auto &trade : trades)
+            {
+                const auto bid = pegs.find(trade.GetBidTrade().orderId_);
+                const auto ask = pegs.find(trade.GetAskTrade().orderId_);
+                if (bid == pegs.end() || ask == pegs.end() || bid->second.reference_ != PegReference::Midpoint || ask->second.reference_ != PegReference::Midpoint)
+                    return "repricing traded something other than two midpoint pegs";
+            }
+            return std::nullopt;
+        };
+
+        for (std::size_t i = 0; i < informations.size(); i++)
+        {
+            const auto &information = informations[i];
+            const auto roll = Roll(100);
+
+            if (roll < 30)
+            {
+                const Side side = Roll(2) == 0 ? Side::Buy : Side::Sell;
+                PegReference reference = Roll(2) == 0 ? PegReference::Midpoint : side == Side::Buy ? PegReference::BestBid : PegReference::BestAsk;
+                Price offset = side == Side::Buy ? -Roll(3) : Roll(3);
+                const bool isAggressive = Roll(10) == 0;
+                if (isAggressive && Roll(2) == 0)
+                    offset = side == Side::Buy ? 1 : -1;
+                else if (isAggressive)
+                    reference = side == Side::Buy ? PegReference::BestAsk : PegReference::BestBid;
+
+                const auto orderType = Roll(2) == 0 ? OrderType::GoodTillCancel : OrderType::GoodForDay;
+                PegState peg{reference, offset, std::make_shared<Order>(orderType, nextPegId++, side, 0, 1 + Roll(20))};
+                const auto expectedPrice = GetExpectedPegPrice(peg, GetUnpeggedBest(Side::Buy), GetUnpeggedBest(Side::Sell));
+                const auto orderId = peg.order_->GetOrderId();
+
+                const auto trades = book.AddPeggedOrder(peg.order_, reference, offset);
+                const bool isAccepted = book.GetQueuePosition(orderId).has_value() || peg.order_->GetFilledQuantity() != 0;
+                if (isAccepted != (!isAggressive && expectedPrice.has_value()))
+                    return DifferentialMismatch{i, "peg " + std::to_string(orderId) + (isAccepted ? " accepted" : " rejected")};
+                if (isAccepted)
+                {
+                    peg.price_ = *expectedPrice;
+                    pegs.emplace(orderId, peg);
+                }
+                if (auto reason = CheckRepricingTrades(trades))
+                    return DifferentialMismatch{i, *reason};
+            }
+            else if (roll < 35 && !pegs.empty())
+            {
+                auto peg = pegs.begin();
+                std::advance(peg, Roll(static_cast<int>(pegs.size())));
+                book.CancelOrder(peg->first);
+                if (auto reason = CheckRepricingTrades(book.TakePegTrades()))
+                    return DifferentialMismatch{i, *reason};
+            }
+
+            // a modify by order id is a cancel and then an add, and the pegs are repriced after the cancel as well
+            const bool wasResting = book.GetQueuePosition(information.orderId_).has_value();
+            if (information.type_ == ActionType::Modify && wasResting)
+            {
+                unpegged.erase(information.orderId_);
+                const auto bestBid = GetUnpeggedBest(Side::Buy);
+                const auto bestAsk = GetUnpeggedBest(Side::Sell);
+                for (auto &[orderId, peg] : pegs)
+                {
+                    if (const auto price = GetExpectedPegPrice(peg, bestBid, bestAsk))
+                        peg.price_ = *price;
+                }
+            }
+
+            auto order = information.type_ == ActionType::Add ? ToOrderPointer(information) : nullptr;
+            if (order != nullptr)
+                book.AddOrder(order);
+            else
+                ApplyInformation(book, information);
+            if (information.type_ == ActionType::Cancel)
+            {
+                if (auto reason = CheckRepricingTrades(book.TakePegTrades()))
+                    return DifferentialMismatch{i, *reason};
+            }
+
+            // a market order rests at the price it was converted to, a modify at its new price
+            if (order != nullptr)
+                unpegged[information.orderId_] = {order->GetSide(), order->GetPrice()};
+            else if (information.type_ == ActionType::Modify && wasResting)
+                unpegged[information.orderId_] = {information.side_, information.price_};
+            std::erase_if(unpegged, [&](const auto &entry)
+                          { return !book.GetQueuePosition(entry.first); });
+            std::erase_if(pegs, [&](const auto &entry)
+                          { return !book.GetQueuePosition(entry.first); });
+
+            const auto bestBid = GetUnpeggedBest(Side::Buy);
+            const auto bestAsk = GetUnpeggedBest(Side::Sell);
+            for (auto &[orderId, peg] : pegs)
+            {
+                if (const auto price = GetExpectedPegPrice(peg, bestBid, bestAsk))
+                    peg.price_ = *price;
+                if (peg.order_->GetPrice() != peg.price_)
+                    return DifferentialMismatch{i, "peg " + std::to_string(orderId) + " rests at " + std::to_string(peg.order_->GetPrice()) + " instead of " + std::to_string(peg.price_)};
+            }
+
+            const auto infos = book.GetOrderInfos();
+            if (!infos.GetBids().empty() && !infos.GetAsks().empty() && infos.GetBids().front().price_ >= infos.GetAsks().front().price_)
+                return DifferentialMismatch{i, "book crossed"};
+        }
+
+        return std::nullopt;
+    }
+
+    CheckResult CheckPegs(std::uint32_t seed, std::size_t count)
+    {
+        if (auto mismatch = CheckPegs<OrderBook>(seed, count))
+            return mismatch;
+        if (auto mismatch = CheckPegs<ProRataOrderBook>(seed, count))
+            return mismatch;
+        return CheckPegs<HybridOrderBook>(seed, count);
+    }
+
+    // a resting order as the pro rata model sees it, levels keep them in time priority
+    struct ModelOrder
+    {
+        OrderId orderId_;
+        Quantity remaining_;
+    };
+
+    struct ModelFill
+    {
+        OrderId restingOrderId_;
+        Price price_;
+        Quantity quantity_;
+    };
+
+    // the model's levels per side by price, ascending for both sides
+    using ModelLevels = std::map<Price, std::vector<ModelOrder>>;
+
+    // a random stream runs through a pro rata or hybrid book next to a model that works out every sweep by brute force: level by
+    // level in price priority, the hybrid book's oldest order fills first, an order that takes the rest of the level fills it in
+    // time priority, and otherwise each resting order gets quantity * remaining / level quantity rounded down and the lots left
+    // over go one at a time in time priority. the book's fills must come out exactly so, and its levels must match the model's
+    template <MatchingPolicy Policy>
+    CheckResult CheckProRata(std::uint32_t seed, std::size_t count)
+    {
+        const auto informations = GenerateInformations(count, seed);
+        BasicOrderBook<Policy> book;
+        ModelLevels levels[2];
+        std::unordered_map<OrderId, std::pair<Side, Price>> resting;
+        const auto GetLevels = [&](Side side) -> ModelLevels &
+        { return levels[side == Side::Buy ? 0 : 1]; };
+
+        const auto Erase = [&](OrderId orderId)
+        {
+            const auto order = resting.find(orderId);
+            if (order == resting.end())
+                return;
+            auto &sideLevels = GetLevels(order->second.first);
+            auto &level = sideLevels.at(order->second.second);
+            std::erase_if(level, [&](const ModelOrder &model)
+                          { return model.orderId_ == orderId; });
+            if (level.empty())
+                sideLevels.erase(order->second.second);
+            resting.erase(order);
+        };
+
+        // the fills an incoming order should make, applied to the model as they are worked out
+        const auto Sweep = [&](Side side, Price price, Quantity &quantity, OrderType orderType)
+        {
+            std::vector<ModelFill> fills;
+            auto &opposite = GetLevels(side == Side::Buy ? Side::Sell : Side::Buy);
+            const auto Crosses = [&](Price restingPrice)
+            { return side == Side::Buy ? restingPrice <= price : restingPrice >= price; };
+
+            if (orderType == OrderType::FillOrKill)
+            {
+                std::uint64_t available{};
+                for (const auto &[restingPrice, level] : opposite)
+                {
+                    for (const auto &order : level)
+                        available += Crosses(restingPrice) ? order.remaining_ : 0;
+                }
+                if (available < quantity)
+                    return fills;
+            }
+
+            while (quantity != 0 && !opposite.empty())
+            {
+                const auto best = side == Side::Buy ? opposite.begin() : std::prev(opposite.end());
+                if (!Crosses(best->first))
+                    break;
+                auto &level = best->second;
+                const auto Fill = [&](ModelOrder &order, Quantity fill)
+                {
+                    fills.push_back(ModelFill{order.orderId_, best->first, fill});
+                    order.remaining_ -= fill;
+                    quantity -= fill;
+                };
+
+                if constexpr (Policy::TopOrderPriority)
+                    Fill(level.front(), std::min(quantity, level.front().remaining_));
+
+                std::uint64_t levelQuantity{};
+                for (const auto &order : level)
+                    levelQuantity += order.remaining_;
+
+                if (quantity >= levelQuantity)
+                {
+                    for (auto &order : level)
+                    {
+                        if (order.remaining_ != 0)
+                            Fill(order, order.remaining_);
+                    }
+                }
+                else if (quantity != 0)
+                {
+                    std::vector<Quantity> allocations;
+                    Quantity allocated{};
+                    for (const auto &order : level)
+                    {
+                        allocations.push_back(static_cast<Quantity>(static_cast<std::uint64_t>(quantity) * order.remaining_ / levelQuantity));
+                        allocated += allocations.back();
+                    }
+                    for (std::size_t i = 0; allocated < quantity; i = (i + 1) % level.size())
+                    {
+                        if (allocations[i] < level[i].remaining_)
+                        {
+                            allocations[i]++;
+                            allocated++;
+                        }
+                    }
+                    for (std::size_t i = 0; i < level.size(); i++)
+                    {
+                        if (allocations[i] != 0)
+                            Fill(level[i], allocations[i]);
+                    }
+                }
+
+                for (const auto &order : level)
+                {
+                    if (order.remaining_ == 0)
+                        resting.erase(order.orderId_);
+                }
+                std::erase_if(level, [](const ModelOrder &order)
+                              { return order.remaining_ == 0; });
+                if (level.empty())
+                    opposite.erase(best);
+
+                // the book cancels a fill and kill order after the first level it trades at
+                if (orderType == OrderType::FillAndKill)
+                    break;
+            }
+            return fills;
+        };
+
+        for (std::size_t i = 0; i < informations.size(); i++)
+        {
+            const auto &information = informations[i];
+            if (information.type_ == ActionType::Cancel)
+            {
+                book.CancelOrder(information.orderId_);
+                Erase(information.orderId_);
+                continue;
+            }
+
+            // a modify is a cancel and an add of the same order type, which rests like good till cancel whatever it was
+            auto orderType = information.orderType_;
+            if (information.type_ == ActionType::Modify)
+            {
+                if (!resting.contains(information.orderId_))
+                {
+                    if (!book.ModifyOrder(ToOrderModify(information)).empty())
+                        return DifferentialMismatch{i, "modify of an order that is not resting traded"};
+                    continue;
+                }
+                orderType = OrderType::GoodTillCancel;
+                Erase(information.orderId_);
+            }
+
+            // a market order is priced at the worst opposite level, with no opposite level it is rejected
+            auto price = information.price_;
+            const auto &opposite = GetLevels(information.side_ == Side::Buy ? Side::Sell : Side::Buy);
+            if (orderType == OrderType::Market && !opposite.empty())
+                price = information.side_ == Side::Buy ? std::prev(opposite.end())->first : opposite.begin()->first;
+            const bool isRejected = orderType == OrderType::Market && opposite.empty();
+
+            Quantity quantity = information.quantity_;
+            const auto fills = isRejected ? std::vector<ModelFill>{} : Sweep(information.side_, price, quantity, orderType);
+            const auto trades = information.type_ == ActionType::Add ? book.AddOrder(ToOrderPointer(information)) : book.ModifyOrder(ToOrderModify(information));
+
+            if (trades.size() != fills.size())
+                return DifferentialMismatch{i, "trade count " + std::to_string(trades.size()) + ", the model sweeps " + std::to_string(fills.size()) + " orders"};
+            for (std::size_t j = 0; j < fills.size(); j++)
+            {
+                const auto &incoming = information.side_ == Side::Buy ? trades[j].GetBidTrade() : trades[j].GetAskTrade();
+                const auto &restingTrade = information.side_ == Side::Buy ? trades[j].GetAskTrade() : trades[j].GetBidTrade();
+                if (incoming.orderId_ != information.orderId_ || restingTrade.orderId_ != fills[j].restingOrderId_ || restingTrade.price_ != fills[j].price_ || restingTrade.quantity_ != fills[j].quantity_ || incoming.quantity_ != fills[j].quantity_)
+                    return DifferentialMismatch{i, "fill " + std::to_string(j) + " of order " + std::to_string(information.orderId_) + " differs from the pro rata model"};
+            }
+
+            // fill and kill, fill or kill and a market order with nothing to trade against never rest
+            const bool rests = quantity != 0 && !isRejected && orderType != OrderType::FillAndKill && orderType != OrderType::FillOrKill;
+            if (rests)
+            {
+                GetLevels(information.side_)[price].push_back(ModelOrder{information.orderId_, quantity});
+                resting[information.orderId_] = {information.side_, price};
+            }
+
+            const auto ToInfos = [](const ModelLevels &sideLevels, Side side)
+            {
+                LevelInfos infos;
+                for (const auto &[levelPrice, level] : sideLevels)
+                {
+                    Quantity levelQuantity{};
+                    for (const auto &order : level)
+                        levelQuantity += order.remaining_;
+                    infos.push_back(LevelInfo{levelPrice, levelQuantity});
+                }
+                if (side == Side::Buy)
+                    std::reverse(infos.begin(), infos.end());
+                return infos;
+            };
+            const auto infos = book.GetOrderInfos();
+            if (auto reason = CompareLevels(infos.GetBids(), ToInfos(GetLevels(Side::Buy), Side::Buy), "bid"))
+                return DifferentialMismatch{i, *reason};
+            if (auto reason = CompareLevels(infos.GetAsks(), ToInfos(GetLevels(Side::Sell), Side::Sell), "ask"))
+                return DifferentialMismatch{i, *reason};
+        }
+
+        return std::nullopt;
+    }
+
+    CheckResult CheckProRata(std::uint32_t seed, std::size_t count)
+    {
+        if (auto mismatch = CheckProRata<ProRataMatching>(seed, count))
+            return mismatch;
+        return CheckProRata<HybridMatching>(seed, count);
+    }
+
+    // the book runs on a simulated clock advanced before every instruction, mostly by minutes but now and then past the session
+    // close, over several days or backwards. at each close the reference cancels its resting good for day orders in order id
+    // order, and the ids AdvanceTime returns, the book's time, the trades and the levels must all match it
+    CheckResult CheckSessionExpiry(std::uint32_t seed, std::size_t count)
+    {
+        using namespace std::chrono;
+        using TimePoint = SessionClock::Clock::time_point;
+
+        const auto informations = GenerateInformations(count, seed);
+        std::mt19937 generator{seed};
+        const auto Roll = [&](int outOf)
+        { return std::uniform_int_distribution<int>{0, outOf - 1}(generator); };
+
+        const auto GetNextClose = [](TimePoint time)
+        {
+            const TimePoint close = floor<days>(time) + SessionClock::DefaultSessionClose;
+            return close > time ? close : close + days{1};
+        };
+
+        OrderBook book;
+        ReferenceOrderBook reference;
+        TimePoint now = sys_days{year{2024} / 3 / 4} + hours{9};
+        TimePoint close = GetNextClose(now);
+        book.UseSimulatedClock(now);
+        std::vector<OrderId> goodForDay;
+
+        for (std::size_t i = 0; i < informations.size(); i++)
+        {
+            const auto &information = informations[i];
+            const auto roll = Roll(100);
+
+            TimePoint time = now + minutes{1 + Roll(20)};
+            if (roll < 3)
+                time = now + days{1 + Roll(3)} + minutes{Roll(600)};
+            else if (roll < 6)
+                time = now - minutes{1 + Roll(60)};
+
+            OrderIds expected;
+            if (time >= close)
+            {
+                std::erase_if(goodForDay, [&](OrderId orderId)
+                              { return !reference.Contains(orderId); });
+                std::sort(goodForDay.begin(), goodForDay.end());
+                for (const auto orderId : goodForDay)
+                    reference.CancelOrder(orderId);
+                expected = std::move(goodForDay);
+                goodForDay.clear();
+                close = GetNextClose(time);
+            }
+            now = std::max(now, time);
+
+            if (book.AdvanceTime(time) != expected)
+                return DifferentialMismatch{i, "expired orders differ from the resting good for day orders at the close"};
+            if (book.GetTime() != now)
+                return DifferentialMismatch{i, "simulated time moved to the wrong time"};
+
+            if (auto reason = CompareTrades(ApplyInformation(book, information), ApplyInformation(reference, information)))
+                return DifferentialMismatch{i, *reason};
+            if (auto reason = CompareBooks(book, reference))
+                return DifferentialMismatch{i, *reason};
+
+            if (information.type_ == ActionType::Add && information.orderType_ == OrderType::GoodForDay)
+                goodForDay.push_back(information.orderId_);
+        }
+
+        return std::nullopt;
+    }
+
+    // adds and modifies go to one book in execution report mode and to another that returns trades and an OrderStatus. every
+    // incoming order, rejected or not, must get exactly one summary carrying the same status, with a fill notice for each trade
+    // the other book made and the filled and remaining quantity they add up to
+    CheckResult CheckExecutionReports(std::uint32_t seed, std::size_t count)
+    {
+        const auto informations = GenerateInformations(count, seed);
+        OrderBook book;
+        OrderBook expectedBook;
+        ExecutionReport report{1, 1'024};
+
+        for (std::size_t i = 0; i < informations.size(); i++)
+        {
+            const auto &information = informations[i];
+            if (information.type_ == ActionType::Cancel)
+            {
+                book.CancelOrder(information.orderId_);
+                expectedBook.CancelOrder(information.orderId_);
+                continue;
+            }
+
+            report.Clear();
+            OrderStatus status;
+            Trades trades;
+            if (information.type_ == ActionType::Add)
+            {
+                book.AddOrder(ToOrderPointer(information), report);
+                trades = expectedBook.AddOrder(ToOrderPointer(information), status);
+            }
+            else
+            {
+                book.ModifyOrder(ToOrderModify(information), report);
+                trades = expectedBook.ModifyOrder(ToOrderModify(information), status);
+            }
+
+            if (report.GetSummaries().size() != 1)
+                return DifferentialMismatch{i, std::to_string(report.GetSummaries().size()) + " summaries for one incoming order"};
+            const auto &summary = report.GetSummaries().front();
+            if (summary.orderId_ != information.orderId_ || summary.status_.reason_ != status.reason_ || summary.status_.riskCheck_ != status.riskCheck_)
+                return DifferentialMismatch{i, "summary status differs from the order status"};
+
+            const auto fills = report.GetFills(summary);
+            if (fills.size() != trades.size())
+                return DifferentialMismatch{i, std::to_string(fills.size()) + " fill notices for " + std::to_string(trades.size()) + " trades"};
+            Quantity filled{};
+            for (std::size_t j = 0; j < fills.size(); j++)
+            {
+                const auto &resting = information.side_ == Side::Buy ? trades[j].GetAskTrade() : trades[j].GetBidTrade();
+                if (fills[j].restingOrderId_ != resting.orderId_ || fills[j].price_ != resting.price_ || fills[j].quantity_ != resting.quantity_)
+                    return DifferentialMismatch{i, "fill notice " + std::to_string(j) + " differs from its trade"};
+                filled += fills[j].quantity_;
+            }
+
+            // a market order and a rejected one are left with what did not fill, anything else that did not rest was killed
+            if (summary.filledQuantity_ != filled || summary.filledQuantity_ + summary.remainingQuantity_ != information.quantity_)
+                return DifferentialMismatch{i, "summary quantities do not add up to the order"};
+            if (auto reason = CompareBooks(book, expectedBook))
+                return DifferentialMismatch{i, *reason};
+        }
+
+        return std::nullopt;
+    }
+
+    // a fill as the trade analytics should count it, at the resting order's price and the book's time
+    struct FillRecord
+    {
+        std::int64_t time_;
+        Price price_;
+        Quantity quantity_;
+        Side aggressorSide_;
+    };
+
+    TradeStatistics SummarizeFills(std::span<const FillRecord> fills)
+    {
+        TradeStatistics statistics;
+        for (const auto &fill : fills)
+        {
+            if (statistics.tradeCount_ == 0)
+                statistics.open_ = statistics.high_ = statistics.low_ = fill.price_;
+            statistics.high_ = std::max(statistics.high_, fill.price_);
+            statistics.low_ = std::min(statistics.low_, fill.price_);
+            statistics.last_ = fill.price_;
+            statistics.volume_ += fill.quantity_;
+            statistics.notional_ += static_cast<std::int64_t>(fill.price_) * fill.quantity_;
+            statistics.tradeCount_++;
+            if (fill.aggressorSide_ == Side::Buy)
+                statistics.buyVolume_ += fill.quantity_;
+        }
+        return statistics;
+    }
+
+    bool IsSameStatistics(const TradeStatistics &left, const TradeStatistics &right)
+    {
+        return left.open_ == right.open_ && left.high_ == right.high_ && left.low_ == right.low_ && left.last_ == right.last_ && left.volume_ == right.volume_ && left.buyVolume_ == right.buyVolume_ && left.notional_ == right.notional_ && left.tradeCount_ == right.tradeCount_ && left.GetVwap() == right.GetVwap();
+    }
+
+    // the simulated clock moves on by up to a second before every instruction and now and then by minutes, so bars of both
+    // intervals end with and without trades after them. the fills the book returns are kept, and the bars the book flushes, its
+    // current bars and its session statistics must match what those fills add up to: every bar whose interval is over has been
+    // closed once, in time order, with the open, high, low, last, volume and vwap of the fills inside its interval
+    CheckResult CheckTradeBars(std::uint32_t seed, std::size_t count)
+    {
+        using namespace std::chrono;
+        using TimePoint = SessionClock::Clock::time_point;
+
+        const auto informations = GenerateInformations(count, seed);
+        std::mt19937 generator{seed};
+        const auto Roll = [&](int outOf)
+        { return std::uniform_int_distribution<int>{0, outOf - 1}(generator); };
+        const auto ToNanoseconds = [](TimePoint time)
+        { return duration_cast<nanoseconds>(time.time_since_epoch()).count(); };
+
+        OrderBook book;
+        TimePoint now = sys_days{year{2024} / 3 / 4} + hours{9} + milliseconds{Roll(1'000)};
+        book.UseSimulatedClock(now);
+        std::vector<FillRecord> fills;
+        TradeBars flushed;
+
+        // fills are recorded in time order, so each bar is a run of them. called right after a flush
+        const auto CheckFlushedBars = [&]() -> std::optional<std::string>
+        {
+            const auto time = ToNanoseconds(now);
+            for (const auto interval : TradeAnalytics::BarIntervals)
+            {
+                std::vector<TradeBar> expected;
+                for (std::size_t begin = 0, end = 0; begin != fills.size(); begin = end)
+                {
+                    const auto start = fills[begin].time_ - fills[begin].time_ % interval.count();
+                    while (end != fills.size() && fills[end].time_ < start + interval.count())
+                        end++;
+                    if (start + interval.count() <= time)
+                        expected.push_back(TradeBar{start, interval.count(), SummarizeFills(std::span{fills}.subspan(begin, end - begin))});
+                }
+
+                std::size_t next{};
+                for (const auto &bar : flushed)
+                {
+                    if (bar.interval_ != interval.count())
+                        continue;
+                    if (next == expected.size() || bar.startTime_ != expected[next].startTime_)
+                        return "bar starting at " + std::to_string(bar.startTime_) + " was closed out of turn";
+                    if (!IsSameStatistics(bar.statistics_, expected[next].statistics_))
+                        return "bar starting at " + std::to_string(bar.startTime_) + " differs from its fills";
+                    next++;
+                }
+                if (next != expected.size())
+                    return "bar starting at " + std::to_string(expected[next].startTime_) + " is over but was not closed";
+            }
+            return std::nullopt;
+        };
+
+        // the current bar holds the fills since the start of the interval the time is in
+        const auto CheckCurrentBars = [&]() -> std::optional<std::string>
+        {
+            const auto time = ToNanoseconds(now);
+            for (const auto interval : TradeAnalytics::BarIntervals)
+            {
+                const auto start = time - time % interval.count();
+                auto first = fills.size();
+                while (first != 0 && fills[first - 1].time_ >= start)
+                    first--;
+                if (!IsSameStatistics(book.GetCurrentBar(interval), SummarizeFills(std::span{fills}.subspan(first))))
+                    return "current " + std::to_string(interval.count()) + "ns bar differs from its fills";
+            }
+            return std::nullopt;
+        };
+
+        for (std::size_t i = 0; i < informations.size(); i++)
+        {
+            const auto &information = informations[i];
+
+            now += milliseconds{Roll(1'000)};
+            if (Roll(100) < 3)
+                now += minutes{1 + Roll(5)};
+            book.AdvanceTime(now);
+
+            for (const auto &trade : ApplyInformation(book, information))
+            {
+                const auto &resting = information.side_ == Side::Buy ? trade.GetAskTrade() : trade.GetBidTrade();
+                fills.push_back(FillRecord{ToNanoseconds(now), resting.price_, resting.quantity_, information.side_});
+            }
+
+            if (auto reason = CheckCurrentBars())
+                return DifferentialMismatch{i, *reason};
+            if (Roll(50) != 0)
+                continue;
+
+            book.FlushTradeBars(flushed);
+            if (auto reason = CheckFlushedBars())
+                return DifferentialMismatch{i, *reason};
+        }
+
+        // once every interval is over all bars must come out, and the current bars are empty
+        now += minutes{2};
+        book.AdvanceTime(now);
+        book.FlushTradeBars(flushed);
+        if (auto reason = CheckFlushedBars())
+            return DifferentialMismatch{count, "at the end, " + *reason};
+        if (auto reason = CheckCurrentBars())
+            return DifferentialMismatch{count, "at the end, " + *reason};
+        if (!IsSameStatistics(book.GetSessionStatistics(), SummarizeFills(fills)))
+            return DifferentialMismatch{count, "session statistics differ from the fills"};
+        if (book.GetDroppedBarCount() != 0)
+            return DifferentialMismatch{count, "bars were dropped"};
+
+        // a reset forgets closed bars that were not flushed as well. a sell and a buy at the same price always trade, with each
+        // other or with the book
+        constexpr OrderId ResetOrderId = 1'000'000'000;
+        book.AddOrder(std::make_shared<Order>(OrderType::GoodTillCancel, ResetOrderId, Side::Sell, 100, 1));
+        book.AddOrder(std::make_shared<Order>(OrderType::GoodTillCancel, ResetOrderId + 1, Side::Buy, 100, 1));
+        book.AdvanceTime(now + minutes{2});
+        book.ResetTradeSession();
+        TradeBars afterReset;
+        book.FlushTradeBars(afterReset);
+        if (book.GetSessionStatistics().tradeCount_ != 0 || !afterReset.empty() || book.GetCurrentBar(seconds{1}).tradeCount_ != 0)
+            return DifferentialMismatch{count, "trade statistics survived a session reset"};
+
+        return std::nullopt;
+    }
+
+    // orders are spread over a few owners so the owner limits are reached as well. their ids are the largest there are, so a
+    // table indexed by owner id would not fit in memory
+    constexpr OwnerId RiskOwnerCount = 4;
+
+    OwnerId GetRiskOwner(OrderId orderId)
+    {
+        return static_cast<OwnerId>(std::numeric_limits<OwnerId>::max() - orderId % RiskOwnerCount);
+    }
+
+    // the risk checks are worked out by hand from the reference before each command reaches it. an order the model turns down
+    // must come back from the book as a RiskCheck reject for the same check and is kept from the reference, everything else
+    // must trade like the reference does
+    CheckResult CheckRiskLimits(std::uint32_t seed, std::size_t count)
+    {
+        const auto informations = GenerateInformations(count, seed);
+        const RiskLimits limits{4, 18, 1'500};
+        const OwnerRiskLimits ownerLimits{100, 60};
+
+        OrderBook book;
+        ReferenceOrderBook reference;
+        book.SetRiskLimits(limits);
+        for (OrderId orderId = 0; orderId < RiskOwnerCount; orderId++)
+            book.SetOwnerRiskLimits(GetRiskOwner(orderId), ownerLimits);
+
+        // the reference fills the orders it is given, so their remaining quantity is the owner's open quantity
+        std::unordered_map<OrderId, OrderPointer> resting;
+        std::unordered_map<OwnerId, std::int64_t> positions;
+        std::optional<Price> lastTrade;
+
+        const auto Evaluate = [&](const Order &order) -> RiskCheck
+        {
+            const auto infos = reference.GetOrderInfos();
+            const auto &ownSide = order.GetSide() == Side::Buy ? infos.GetBids() : infos.GetAsks();
+            const auto &otherSide = order.GetSide() == Side::Buy ? infos.GetAsks() : infos.GetBids();
+
+            Price price = order.GetPrice();
+            if (order.GetOrderType() == OrderType::Market)
+                price = otherSide.back().price_;
+
+            auto referencePrice = lastTrade;
+            if (!referencePrice && !otherSide.empty())
+                referencePrice = otherSide.front().price_;
+            if (!referencePrice && !ownSide.empty())
+                referencePrice = ownSide.front().price_;
+
+            const auto quantity = order.GetRemainingQuantity();
+            if (referencePrice && std::abs(static_cast<std::int64_t>(price) - *referencePrice) > limits.priceBand_)
+                return RiskCheck::PriceBand;
+            if (quantity > limits.maxOrderQuantity_)
+                return RiskCheck::OrderQuantity;
+            if (static_cast<std::int64_t>(price) * quantity > limits.maxNotional_)
+                return RiskCheck::Notional;
+
+            const auto ownerId = order.GetOwnerId();
+            std::uint64_t openQuantity = quantity;
+            for (const auto &[orderId, restingOrder] : resting)
+            {
+                if (GetRiskOwner(orderId) == ownerId && reference.Contains(orderId))
+                    openQuantity += restingOrder->GetRemainingQuantity();
+            }
+            if (openQuantity > ownerLimits.maxOpenQuantity_)
+                return RiskCheck::OpenQuantity;
+
+            const auto position = positions[ownerId] + (order.GetSide() == Side::Buy ? static_cast<std::int64_t>(quantity) : -static_cast<std::int64_t>(quantity));
+            if (std::abs(position) > ownerLimits.maxPosition_)
+                return RiskCheck::Position;
+
+            return RiskCheck::Passed;
+        };
+
+        for (std::size_t i = 0; i < informations.size(); i++)
+        {
+            const auto &information = informations[i];
+            const auto ownerId = GetRiskOwner(information.orderId_);
+            Trades trades, expected;
+            OrderStatus status;
+            std::optional<RiskCheck> check;
+
+            // a modify cancels first and checks the replacement against the book without the old order, as the book does
+            OrderPointer order;
+            if (information.type_ == ActionType::Add)
+            {
+                order = std::make_shared<Order>(information.orderType_, information.orderId_, information.side_, information.price_, information.quantity_, ownerId);
+                trades = book.AddOrder(std::make_shared<Order>(*order), status);
+            }
+            else if (information.type_ == ActionType::Modify && reference.Contains(information.orderId_))
+            {
+                const auto orderType = resting.at(information.orderId_)->GetOrderType();
+                order = std::make_shared<Order>(orderType, information.orderId_, information.side_, information.price_, information.quantity_, ownerId);
+                reference.CancelOrder(information.orderId_);
+                trades = book.ModifyOrder(ToOrderModify(information), status);
+            }
+            else if (information.type_ == ActionType::Modify)
+            {
+                trades = book.ModifyOrder(ToOrderModify(information), status);
+            }
+            else
+            {
+                book.CancelOrder(information.orderId_);
+                reference.CancelOrder(information.orderId_);
+            }
+
+            // a market order with nothing to trade against is turned down before the checks
+            const bool hasLiquidity = order == nullptr || order->GetOrderType() != OrderType::Market || (information.side_ == Side::Buy ? reference.GetOrderInfos().GetAsks() : reference.GetOrderInfos().GetBids()).size() != 0;
+            if (order != nullptr && hasLiquidity)
+                check = Evaluate(*order);
+
+            const bool isRejected = status.reason_ == RejectReason::RiskCheck;
+            if (check.value_or(RiskCheck::Passed) != (isRejected ? status.riskCheck_ : RiskCheck::Passed))
+                return DifferentialMismatch{i, std::string{"risk check "} + RiskGate::GetName(status.riskCheck_) + ", expected " + RiskGate::GetName(check.value_or(RiskCheck::Passed))};
+
+            if (check == RiskCheck::Passed)
+            {
+                expected = reference.AddOrder(order);
+                resting[order->GetOrderId()] = order;
+            }
+
+            if (auto reason = CompareTrades(trades, expected))
+                return DifferentialMismatch{i, *reason};
+            if (auto reason = CompareBooks(book, reference))
+                return DifferentialMismatch{i, *reason};
+
+            // the session's last trade prints at the resting order's price
+            for (const auto &trade : expected)
+            {
+                positions[GetRiskOwner(trade.GetBidTrade().orderId_)] += trade.GetBidTrade().quantity_;
+                positions[GetRiskOwner(trade.GetAskTrade().orderId_)] -= trade.GetAskTrade().quantity_;
+            }
+            if (!expected.empty())
+                lastTrade = information.side_ == Side::Buy ? expected.back().GetAskTrade().price_ : expected.back().GetBidTrade().price_;
+
+            std::erase_if(resting, [&](const auto &entry)
+                          { return !reference.Contains(entry.first); });
+        }
+
+        return std::nullopt;
+    }
+
+    struct Check
+    {
+        const char *name_;
+        CheckResult (*run_)(std::uint32_t seed, std::size_t count);
+    };
+}
+
+int main(int argc, char **argv)
+{
+    const std::uint32_t seeds = argc > 1 ? std::stoul(argv[1]) : 50;
+    const std::size_t count = argc > 2 ? std::stoul(argv[2]) : 2'000;
+
+    const Check checks[] = {
+        {"handles", CheckHandles},
+        {"risk limits", CheckRiskLimits},
+        {"queue positions", CheckQueuePositions},
+        {"mass cancels", CheckMassCancels},
+        {"mass quotes", CheckMassQuotes},
+        {"pegs", CheckPegs},
+        {"pro rata", CheckProRata},
+        {"session expiry", CheckSessionExpiry},
+        {"execution reports", CheckExecutionReports},
+        {"trade bars", CheckTradeBars},
+    };
+
+    for (const auto &check : checks)
+    {
+        for (std::uint32_t seed = 1; seed <= seeds; seed++)
+        {
+            if (const auto mismatch = check.run_(seed, count))
+            {
+                std::cerr << "MISMATCH " << check.name_ << " seed " << seed << " instruction " << mismatch->instruction_ << ": " << mismatch->reason_ << "\n";
+                return 1;
+            }
+        }
+        std::cout << check.name_ << ": " << seeds << " seeds x " << count << " instructions matched\n";
+    }
+    return 0;
+}
@@ -0,0 +1,417 @@
+#include "../OrderBook.h"
+#include "../SharedMemoryRing.h"
+#include "GatewayProtocol.h"
+
+#include <sys/epoll.h>
+#include <array>
+#include <csignal>
+#include <cerrno>
+#include <iostream>
+#include <memory>
+#include <optional>
+#include <unordered_map>
+#include <vector>
+
+// order entry gateway: accepts client connections on a unix domain or loopback tcp socket, decodes fixed size binary
+// requests straight out of each connection's read buffer, drives the order book and answers with acks and fills.
+// sockets are edge triggered, and responses are queued per connection and written once per epoll wake up.
+// every connection is an owner in the book, so its resting orders are cancelled as soon as it disconnects.
+// with --market-data the book also publishes trades and level changes into a shared memory ring for same host subscribers.
+// usage: Gateway <unix:/path | tcp:port> [--market-data /name]
+
+namespace
+{
+    volatile std::sig_atomic_t stopRequested = 0;
+
+    void RequestStop(int)
+    {
+        stopRequested = 1;
+    }
+}
+
+class Gateway
+{
+public:
+    Gateway(const Endpoint &endpoint, MarketDataPublisher *publisher) : endpoint_{endpoint}, listener_{Listen(endpoint)}, epoll_{epoll_create1(0)}
+    {
+        orderBook_.SetMarketDataPublisher(publisher);
+        if (epoll_ < 0)
+            throw std::system_error(errno, std::generic_category(), "epoll_create1");
+        Register(listener_, ListenerId, EPOLLIN | EPOLLET);
+        owners_.reserve(1 << 16);
+        dirty_.reserve(MaxEvents);
+    }
+
+    ~Gateway()
+    {
+        for (auto &[_, connection] : connections_)
+            close(connection->fd_);
+        close(listener_);
+        close(epoll_);
+        if (endpoint_.isUnix_)
+            unlink(endpoint_.path_.c_str());
+    }
+
+    void Run()
+    {
+        std::array<epoll_event, MaxEvents> events;
+
+        while (!stopRequested)
+        {
+            int count = epoll_wait(epoll_, events.data(), MaxEvents, -1);
+            if (count < 0)
+            {
+                if (errno == EINTR)
+                    continue;
+                throw std::system_error(errno, std::generic_category(), "epoll_wait");
+            }
+
+            for (int i = 0; i < count; i++)
+            {
+                const auto id = events[i].data.u64;
+                if (id == ListenerId)
+                {
+                    Accept();
+                    continue;
+                }
+
+                auto found = connections_.find(id);
+                if (found == connections_.end())
+                    continue;
+
+                auto &connection = *found->second;
+                if (events[i].events & (EPOLLIN | EPOLLRDHUP | EPOLLHUP | EPOLLERR))
+                    Read(connection);
+                if (events[i].events & EPOLLOUT)
+                    Flush(connection);
+            }
+
+            // one write per connection for everything produced during this wake up
+            for (auto *connection : dirty_)
+            {
+                connection->isDirty_ = false;
+                Flush(*connection);
+            }
+            dirty_.clear();
+
+            for (auto id : closed_)
+                connections_.erase(id);
+            closed_.clear();
+        }
+    }
+
+private:
+    static constexpr std::uint64_t ListenerId = 0;
+    static constexpr std::size_t BufferSize = 64 * 1024;
+    static constexpr int MaxEvents = 256;
+
+    struct Connection
+    {
+        std::uint64_t id_;
+        int fd_;
+        // the read buffer is allocated once, requests are decoded in place and partial messages are moved to the front
+        std::vector<char> input_ = std::vector<char>(BufferSize);
+        std::size_t inputLength_{};
+        std::vector<char> output_;
+        std::size_t outputOffset_{};
+        bool isDirty_{false};
+        bool isClosed_{false};
+    };
+
+    // the connection that owns each live order and how much of it is still open, used to route fills
+    struct Owner
+    {
+        std::uint64_t connectionId_;
+        Quantity remainingQuantity_;
+    };
+
+    Endpoint endpoint_;
+    int listener_;
+    int epoll_;
+    std::uint64_t nextConnectionId_{ListenerId + 1};
+    std::unordered_map<std::uint64_t, std::unique_ptr<Connection>> connections_;
+    std::unordered_map<OrderId, Owner> owners_;
+    std::vector<Connection *> dirty_;
+    std::vector<std::uint64_t> closed_;
+    OrderBook orderBook_;
+
+    static OwnerId GetOwnerId(const Connection &connection) { return static_cast<OwnerId>(connection.id_); }
+
+    void Register(int fd, std::uint64_t id, std::uint32_t events)
+    {
+        epoll_event event{};
+        event.events = events;
+        event.data.u64 = id;
+        if (epoll_ctl(epoll_, EPOLL_CTL_ADD, fd, &event) < 0)
+            throw std::system_error(errno, std::generic_category(), "epoll_ctl");
+    }
+
+    void Accept()
+    {
+        while (true)
+        {
+            int fd = accept4(listener_, nullptr, nullptr, SOCK_NONBLOCK);
+            if (fd < 0)
+            {
+                if (errno == EINTR)
+                    continue;
+                return;
+            }
+
+            SetNoDelay(endpoint_, fd);
+
+            auto connection = std::make_unique<Connection>();
+            connection->id_ = nextConnectionId_++;
+            connection->fd_ = fd;
+            connection->output_.reserve(BufferSize);
+
+            Register(fd, connection->id_, EPOLLIN | EPOLLOUT | EPOLLRDHUP | EPOLLET);
+            connections_.emplace(connection->id_, std::move(connection));
+        }
+    }
+
+    void Close(Connection &connection)
+    {
+        if (connection.isClosed_)
+            return;
+
+        // closing the descriptor also removes it from the epoll set, the record itself lives until the end of the wake up
+        connection.isClosed_ = true;
+        close(connection.fd_);
+        closed_.push_back(connection.id_);
+
+        // cancel on disconnect
+        for (auto orderId : orderBook_.CancelAllForOwner(GetOwnerId(connection)))
+            owners_.erase(orderId);
+    }
+
+    void Read(Connection &connection)
+    {
+        // edge triggered, so keep reading until the socket is drained
+        while (!connection.isClosed_)
+        {
+            auto read = ::read(connection.fd_, connection.input_.data() + connection.inputLength_, connection.input_.size() - connection.inputLength_);
+            if (read > 0)
+            {
+                connection.inputLength_ += read;
+                Decode(connection);
+            }
+            else if (read == 0)
+                Close(connection);
+            else if (errno == EINTR)
+                continue;
+            else
+            {
+                if (errno != EAGAIN && errno != EWOULDBLOCK)
+                    Close(connection);
+                return;
+            }
+        }
+    }
+
+    void Decode(Connection &connection)
+    {
+        std::size_t offset{};
+        RequestMessage request;
+
+        while (connection.inputLength_ - offset >= sizeof(RequestMessage))
+        {
+            std::memcpy(&request, connection.input_.data() + offset, sizeof(RequestMessage));
+            offset += sizeof(RequestMessage);
+            Handle(connection, request);
+        }
+
+        connection.inputLength_ -= offset;
+        if (connection.inputLength_ != 0 && offset != 0)
+            std::memmove(connection.input_.data(), connection.input_.data() + offset, connection.inputLength_);
+    }
+
+    void Handle(Connection &connection, const RequestMessage &request)
+    {
+        if (!IsWellFormed(request))
+            return Respond(connection, ResponseType::Reject, request, RejectReason::InvalidOrder);
+
+        auto owner = owners_.find(request.orderId_);
+        const bool isOwner = owner != owners_.end() && owner->second.connectionId_ == connection.id_;
+
+        switch (request.type_)
+        {
+        case RequestType::Add:
+        {
+            if (owner != owners_.end())
+                return Respond(connection, ResponseType::Reject, request, RejectReason::DuplicateOrderId);
+
+            owners_.emplace(request.orderId_, Owner{connection.id_, request.quantity_});
+            OrderStatus status;
+            const auto trades = orderBook_.AddOrder(std::make_shared<Order>(request.orderType_, request.orderId_, request.side_, request.price_, request.quantity_, GetOwnerId(connection)), status);
+            if (!status.IsAccepted())
+            {
+                owners_.erase(request.orderId_);
+                return Respond(connection, ResponseType::Reject, request, status.reason_);
+            }
+            Respond(connection, ResponseType::Ack, request);
+            SendFills(trades, connection.id_, request.clientTimestamp_);
+
+            // these order types never rest, whatever did not fill is gone from the book
+            const bool neverRests = request.orderType_ == OrderType::FillAndKill || request.orderType_ == OrderType::FillOrKill || (request.orderType_ == OrderType::Market && trades.empty());
+            if (neverRests)
+                owners_.erase(request.orderId_);
+        }
+        break;
+        case RequestType::Modify:
+        {
+            if (!isOwner)
+                return Respond(connection, ResponseType::Reject, request);
+
+            owner->second.remainingQuantity_ = request.quantity_;
+            OrderStatus status;
+            const auto trades = orderBook_.ModifyOrder(OrderModify(request.orderId_, request.side_, request.price_, request.quantity_), status);
+            if (!status.IsAccepted())
+            {
+                // the old order is gone either way, a modify of an order that already traded out or a rejected replacement
+                owners_.erase(owner);
+                return Respond(connection, ResponseType::Reject, request, status.reason_);
+            }
+            Respond(connection, ResponseType::Ack, request);
+            SendFills(trades, connection.id_, request.clientTimestamp_);
+        }
+        break;
+        case RequestType::Cancel:
+        {
+            if (!isOwner)
+                return Respond(connection, ResponseType::Reject, request);
+
+            orderBook_.CancelOrder(request.orderId_);
+            owners_.erase(owner);
+            Respond(connection, ResponseType::Ack, request);
+        }
+        break;
+        case RequestType::MassCancel:
+        {
+            MassCancelFilter filter;
+            if (request.flags_ & RequestFlags::MassCancelBySide)
+                filter.side_ = request.side_;
+
+            const auto orderIds = orderBook_.MassCancel(GetOwnerId(connection), filter);
+            for (auto orderId : orderIds)
+                owners_.erase(orderId);
+
+            // the ack carries the number of orders cancelled in the quantity
+            auto response = request;
+            response.quantity_ = static_cast<Quantity>(orderIds.size());
+            Respond(connection, ResponseType::Ack, response);
+        }
+        break;
+        default:
+            Respond(connection, ResponseType::Reject, request);
+        }
+    }
+
+    void Respond(Connection &connection, ResponseType type, const RequestMessage &request, RejectReason reason = RejectReason::None)
+    {
+        Send(connection, ResponseMessage{type, request.side_, reason, {}, request.price_, request.quantity_, 0, request.orderId_, request.clientTimestamp_});
+    }
+
+    void SendFills(const Trades &trades, std::uint64_t aggressorId, std::uint64_t clientTimestamp)
+    {
+        for (const auto &trade : trades)
+        {
+            SendFill(Side::Buy, trade.GetBidTrade(), aggressorId, clientTimestamp);
+            SendFill(Side::Sell, trade.GetAskTrade(), aggressorId, clientTimestamp);
+        }
+    }
+
+    void SendFill(Side side, const TradeInfo &trade, std::uint64_t aggressorId, std::uint64_t clientTimestamp)
+    {
+        auto owner = owners_.find(trade.orderId_);
+        if (owner == owners_.end())
+            return;
+
+        const auto connectionId = owner->second.connectionId_;
+        owner->second.remainingQuantity_ -= std::min(owner->second.remainingQuantity_, trade.quantity_);
+        if (owner->second.remainingQuantity_ == 0)
+            owners_.erase(owner);
+
+        auto connection = connections_.find(connectionId);
+        if (connection == connections_.end())
+            return;
+
+        // only the aggressor's own fills carry its timestamp, resting orders were sent earlier
+        const auto timestamp = connectionId == aggressorId ? clientTimestamp : 0;
+        Send(*connection->second, ResponseMessage{ResponseType::Fill, side, RejectReason::None, {}, trade.price_, trade.quantity_, 0, trade.orderId_, timestamp});
+    }
+
+    void Send(Connection &connection, const ResponseMessage &response)
+    {
+        if (connection.isClosed_)
+            return;
+
+        const auto *bytes = reinterpret_cast<const char *>(&response);
+        connection.output_.insert(connection.output_.end(), bytes, bytes + sizeof(ResponseMessage));
+
+        if (!connection.isDirty_)
+        {
+            connection.isDirty_ = true;
+            dirty_.push_back(&connection);
+        }
+    }
+
+    void Flush(Connection &connection)
+    {
+        while (!connection.isClosed_ && connection.outputOffset_ < connection.output_.size())
+        {
+            auto written = ::write(connection.fd_, connection.output_.data() + connection.outputOffset_, connection.output_.size() - connection.outputOffset_);
+            if (written > 0)
+                connection.outputOffset_ += written;
+            else if (errno == EINTR)
+                continue;
+            else
+            {
+                // whatever is left goes out on the next EPOLLOUT edge
+                if (errno != EAGAIN && errno != EWOULDBLOCK)
+                    Close(connection);
+                return;
+            }
+        }
+
+        connection.output_.clear();
+        connection.outputOffset_ = 0;
+    }
+};
+
+int main(int argc, char **argv)
+{
+    if (argc < 2)
+    {
+        std::cerr << "usage: Gateway <unix:/path | tcp:port> [--market-data /name]\n";
+        return 1;
+    }
+
+    struct sigaction action{};
+    action.sa_handler = RequestStop;
+    sigaction(SIGINT, &action, nullptr);
+    sigaction(SIGTERM, &action, nullptr);
+    signal(SIGPIPE, SIG_IGN);
+
+    try
+    {
+        std::optional<SharedMemoryRing> marketDataRing;
+        std::optional<MarketDataPublisher> marketDataPublisher;
+        if (argc > 3 && std::string_view{argv[2]} == "--market-data")
+        {
+            marketDataRing.emplace(SharedMemoryRing::Create(argv[3], 1 << 16));
+            marketDataPublisher.emplace(marketDataRing->GetRing());
+        }
+
+        Gateway gateway{ParseEndpoint(argv[1]), marketDataPublisher ? &*marketDataPublisher : nullptr};
+        std::cout << "LISTENING " << argv[1] << std::endl;
+        gateway.Run();
+        std::cout << "STOPPED" << std::endl;
+        return 0;
+    }
+    catch (const std::exception &e)
+    {
+        std::cerr << "Error: " << e.what() << std::endl;
+        return 1;
+    }
+}
@@ -0,0 +1,183 @@
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <type_traits>
+
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+#include <unistd.h>
+
+#include "../Usings.h"
+#include "../Side.h"
+#include "../OrderType.h"
+#include "../OrderStatus.h"
+
+// fixed size binary messages exchanged between the gateway and its clients over a stream socket.
+// every message is 32 bytes in host byte order, the gateway only serves clients on the same host
+
+enum class RequestType : std::uint8_t
+{
+    Add = 'A',
+    Modify = 'M',
+    Cancel = 'C',
+    // cancels every order of the sending connection, only those on side_ when MassCancelBySide is set in flags_
+    MassCancel = 'X',
+};
+
+enum RequestFlags : std::uint8_t
+{
+    MassCancelBySide = 1 << 0,
+};
+
+enum class ResponseType : std::uint8_t
+{
+    Ack = 'K',
+    Reject = 'R',
+    Fill = 'F',
+};
+
+struct RequestMessage
+{
+    RequestType type_;
+    Side side_;
+    OrderType orderType_;
+    std::uint8_t flags_;
+    Price price_;
+    Quantity quantity_;
+    std::uint32_t padding_;
+    OrderId orderId_;
+    // client send time, echoed back in the ack and in fills caused by this request so the client can measure round trip latency
+    std::uint64_t clientTimestamp_;
+};
+
+struct ResponseMessage
+{
+    ResponseType type_;
+    Side side_;
+    // why a Reject was sent. InvalidOrder for a malformed request, None for a cancel or modify of an order the connection does
+    // not own
+    RejectReason reason_;
+    std::uint8_t reserved_;
+    Price price_;
+    Quantity quantity_;
+    std::uint32_t padding_;
+    OrderId orderId_;
+    std::uint64_t clientTimestamp_;
+};
+
+// fields are copied straight off the wire, anything the book could misread is refused before it gets there
+inline bool IsWellFormed(const RequestMessage &request)
+{
+    const bool isValidSide = request.side_ == Side::Buy || request.side_ == Side::Sell;
+    switch (request.type_)
+    {
+    case RequestType::Add:
+        return isValidSide && request.orderType_ <= OrderType::Market && request.quantity_ != 0;
+    case RequestType::Modify:
+        return isValidSide && request.quantity_ != 0;
+    case RequestType::Cancel:
+        return true;
+    case RequestType::MassCancel:
+        return !(request.flags_ & RequestFlags::MassCancelBySide) || isValidSide;
+    default:
+        return false;
+    }
+}
+
+static_assert(sizeof(RequestMessage) == 32 && std::is_trivially_copyable_v<RequestMessage>, "RequestMessage is sent as raw bytes");
+static_assert(sizeof(ResponseMessage) == 32 && std::is_trivially_copyable_v<ResponseMessage>, "ResponseMessage is sent as raw bytes");
+
+// "unix:/path/to/socket" or "tcp:port", tcp endpoints are always bound to the loopback interface
+struct Endpoint
+{
+    bool isUnix_;
+    std::string path_;
+    std::uint16_t port_;
+};
+
+inline Endpoint ParseEndpoint(std::string_view text)
+{
+    if (text.starts_with("unix:"))
+        return Endpoint{true, std::string{text.substr(5)}, 0};
+    if (text.starts_with("tcp:"))
+        return Endpoint{false, {}, static_cast<std::uint16_t>(std::stoul(std::string{text.substr(4)}))};
+
+    throw std::logic_error("Endpoint must be unix:<path> or tcp:<port>");
+}
+
+inline int OpenSocket(const Endpoint &endpoint, int flags)
+{
+    int fd = socket(endpoint.isUnix_ ? AF_UNIX : AF_INET, SOCK_STREAM | flags, 0);
+    if (fd < 0)
+        throw std::system_error(errno, std::generic_category(), "socket");
+    return fd;
+}
+
+// calls the given bind or connect function with the socket address for the endpoint
+template <typename Function>
+int WithAddress(const Endpoint &endpoint, Function function)
+{
+    if (endpoint.isUnix_)
+    {
+        sockaddr_un address{};
+        address.sun_family = AF_UNIX;
+        if (endpoint.path_.size() >= sizeof(address.sun_path))
+            throw std::logic_error("Unix socket path is too long");
+        std::memcpy(address.sun_path, endpoint.path_.c_str(), endpoint.path_.size() + 1);
+        return function(reinterpret_cast<const sockaddr *>(&address), sizeof(address));
+    }
+
+    sockaddr_in address{};
+    address.sin_family = AF_INET;
+    address.sin_port = htons(endpoint.port_);
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    return function(reinterpret_cast<const sockaddr *>(&address), sizeof(address));
+}
+
+inline void SetNoDelay(const Endpoint &endpoint, int fd)
+{
+    if (endpoint.isUnix_)
+        return;
+    int enable = 1;
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &enable, sizeof(enable));
+}
+
+inline int Listen(const Endpoint &endpoint)
+{
+    int fd = OpenSocket(endpoint, SOCK_NONBLOCK);
+
+    if (endpoint.isUnix_)
+        unlink(endpoint.path_.c_str());
+    else
+    {
+        int enable = 1;
+        setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &enable, sizeof(enable));
+    }
+
+    if (WithAddress(endpoint, [fd](const sockaddr *address, socklen_t length)
+                    { return bind(fd, address, length); }) < 0)
+        throw std::system_error(errno, std::generic_category(), "bind");
+    if (listen(fd, SOMAXCONN) < 0)
+        throw std::system_error(errno, std::generic_category(), "listen");
+
+    return fd;
+}
+
+inline int Connect(const Endpoint &endpoint)
+{
+    int fd = OpenSocket(endpoint, 0);
+
+    if (WithAddress(endpoint, [fd](const sockaddr *address, socklen_t length)
+                    { return connect(fd, address, length); }) < 0)
+        throw std::system_error(errno, std::generic_category(), "connect");
+
+    SetNoDelay(endpoint, fd);
+    return fd;
+}
@@ -0,0 +1,209 @@
+#include "GatewayProtocol.h"
+
+#include <algorithm>
+#include <chrono>
+#include <exception>
+#include <iostream>
+#include <random>
+#include <thread>
+#include <vector>
+
+// load generator for the gateway: each connection runs on its own thread, keeps up to a window of requests in flight and
+// measures wire to wire latency from the client timestamp echoed back in every ack.
+// usage: LoadGenerator <unix:/path | tcp:port> [connections] [requests per connection] [window]
+
+namespace
+{
+    std::uint64_t Now()
+    {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+
+    struct ConnectionResult
+    {
+        std::vector<std::uint64_t> latencies_;
+        std::size_t fills_{};
+        std::size_t rejects_{};
+        // what stopped the connection early, rethrown by main once every thread has joined
+        std::exception_ptr error_;
+    };
+
+    void WriteAll(int fd, const char *data, std::size_t size)
+    {
+        while (size != 0)
+        {
+            auto written = ::write(fd, data, size);
+            if (written < 0)
+            {
+                if (errno == EINTR)
+                    continue;
+                throw std::system_error(errno, std::generic_category(), "write");
+            }
+            data += written;
+            size -= written;
+        }
+    }
+
+    void RunRequests(int fd, std::size_t index, std::size_t requestCount, std::size_t window, ConnectionResult &result)
+    {
+        std::mt19937 generator{static_cast<std::uint32_t>(index + 1)};
+        std::uniform_int_distribution<int> percent{0, 99};
+        std::uniform_int_distribution<Price> price{90, 110};
+        std::uniform_int_distribution<Quantity> quantity{1, 10};
+
+        // order ids are partitioned by connection so the connections never collide
+        const OrderId firstOrderId = (static_cast<OrderId>(index) + 1) << 40;
+        OrderId nextOrderId = firstOrderId;
+
+        std::vector<RequestMessage> requests(window);
+        std::vector<char> input(64 * 1024);
+        std::size_t inputLength{};
+        std::size_t sent{}, acked{};
+
+        result.latencies_.reserve(requestCount);
+
+        while (acked < requestCount)
+        {
+            // top the window back up in one write
+            std::size_t batch{};
+            while (sent + batch < requestCount && sent - acked + batch < window)
+            {
+                auto &request = requests[batch++];
+                request = RequestMessage{};
+
+                if (nextOrderId != firstOrderId && percent(generator) < 20)
+                {
+                    request.type_ = RequestType::Cancel;
+                    request.orderId_ = std::uniform_int_distribution<OrderId>{firstOrderId, nextOrderId - 1}(generator);
+                }
+                else
+                {
+                    request.type_ = RequestType::Add;
+                    request.side_ = percent(generator) < 50 ? Side::Buy : Side::Sell;
+                    request.orderType_ = OrderType::GoodTillCancel;
+                    request.price_ = price(generator);
+                    request.quantity_ = quantity(generator);
+                    request.orderId_ = nextOrderId++;
+                }
+                request.clientTimestamp_ = Now();
+            }
+
+            if (batch != 0)
+            {
+                WriteAll(fd, reinterpret_cast<const char *>(requests.data()), batch * sizeof(RequestMessage));
+                sent += batch;
+            }
+
+            auto read = ::read(fd, input.data() + inputLength, input.size() - inputLength);
+            if (read <= 0)
+            {
+                if (read < 0 && errno == EINTR)
+                    continue;
+                throw std::logic_error("Gateway closed the connection");
+            }
+            inputLength += read;
+
+            const auto now = Now();
+            std::size_t offset{};
+            ResponseMessage response;
+
+            while (inputLength - offset >= sizeof(ResponseMessage))
+            {
+                std::memcpy(&response, input.data() + offset, sizeof(ResponseMessage));
+                offset += sizeof(ResponseMessage);
+
+                if (response.type_ == ResponseType::Fill)
+                {
+                    result.fills_++;
+                    continue;
+                }
+
+                if (response.type_ == ResponseType::Reject)
+                    result.rejects_++;
+                result.latencies_.push_back(now - response.clientTimestamp_);
+                acked++;
+            }
+
+            inputLength -= offset;
+            std::memmove(input.data(), input.data() + offset, inputLength);
+        }
+    }
+
+    // an exception escaping a thread would terminate the process, so it is handed back to main in the result
+    void RunConnection(const Endpoint &endpoint, std::size_t index, std::size_t requestCount, std::size_t window, ConnectionResult &result)
+    {
+        int fd = -1;
+        try
+        {
+            fd = Connect(endpoint);
+            RunRequests(fd, index, requestCount, window, result);
+        }
+        catch (...)
+        {
+            result.error_ = std::current_exception();
+        }
+
+        if (fd >= 0)
+            close(fd);
+    }
+
+    std::uint64_t Percentile(const std::vector<std::uint64_t> &sorted, double percentile)
+    {
+        if (sorted.empty())
+            return 0;
+        return sorted[std::min(sorted.size() - 1, static_cast<std::size_t>(percentile * sorted.size()))];
+    }
+}
+
+int main(int argc, char **argv)
+{
+    if (argc < 2)
+    {
+        std::cerr << "usage: LoadGenerator <unix:/path | tcp:port> [connections] [requests per connection] [window]\n";
+        return 1;
+    }
+
+    try
+    {
+        const auto endpoint = ParseEndpoint(argv[1]);
+        const std::size_t connections = argc > 2 ? std::stoul(argv[2]) : 4;
+        const std::size_t requestCount = argc > 3 ? std::stoul(argv[3]) : 100'000;
+        const std::size_t window = std::max<std::size_t>(1, argc > 4 ? std::stoul(argv[4]) : 32);
+
+        std::vector<ConnectionResult> results(connections);
+        std::vector<std::thread> threads;
+
+        const auto start = Now();
+        for (std::size_t i = 0; i < connections; i++)
+            threads.emplace_back(RunConnection, std::cref(endpoint), i, requestCount, window, std::ref(results[i]));
+        for (auto &thread : threads)
+            thread.join();
+        const auto elapsed = Now() - start;
+
+        for (const auto &result : results)
+        {
+            if (result.error_)
+                std::rethrow_exception(result.error_);
+        }
+
+        std::vector<std::uint64_t> latencies;
+        std::size_t fills{}, rejects{};
+        for (const auto &result : results)
+        {
+            latencies.insert(latencies.end(), result.latencies_.begin(), result.latencies_.end());
+            fills += result.fills_;
+            rejects += result.rejects_;
+        }
+        std::sort(latencies.begin(), latencies.end());
+
+        std::cout << "requests: " << latencies.size() << ", fills: " << fills << ", rejects: " << rejects << "\n";
+        std::cout << "throughput: " << static_cast<std::uint64_t>(latencies.size() * 1e9 / elapsed) << " requests/s\n";
+        std::cout << "latency ns p50: " << Percentile(latencies, 0.5) << ", p99: " << Percentile(latencies, 0.99) << ", p99.9: " << Percentile(latencies, 0.999) << ", max: " << (latencies.empty() ? 0 : latencies.back()) << "\n";
+        return 0;
+    }
+    catch (const std::exception &e)
+    {
+        std::cerr << "Error: " << e.what() << std::endl;
+        return 1;
+    }
+}
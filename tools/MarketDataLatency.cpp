@@ -0,0 +1,102 @@
+#include "../OrderBook.h"
+#include "../BookDifferential.h"
+#include "../SharedMemoryRing.h"
+
+#include <algorithm>
+#include <atomic>
+#include <iostream>
+#include <thread>
+
+// measures publish to receive latency through the shared memory market data ring. the book publishes from this thread while
+// a subscriber thread maps the ring by name on its own, exactly as a separate strategy process would, and timestamps every event.
+// an interval between instructions keeps the subscriber from falling behind, so the latency is transport rather than queueing delay.
+// usage: MarketDataLatency [instructions] [ring capacity] [interval between instructions in ns]
+
+namespace
+{
+    std::uint64_t Now()
+    {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+
+    std::uint64_t Percentile(const std::vector<std::uint64_t> &sorted, double percentile)
+    {
+        if (sorted.empty())
+            return 0;
+        return sorted[std::min(sorted.size() - 1, static_cast<std::size_t>(percentile * sorted.size()))];
+    }
+}
+
+int main(int argc, char **argv)
+{
+    const std::size_t count = argc > 1 ? std::stoul(argv[1]) : 1'000'000;
+    const std::size_t capacity = argc > 2 ? std::stoul(argv[2]) : 1 << 16;
+    const std::uint64_t interval = argc > 3 ? std::stoull(argv[3]) : 1'000;
+    const std::string name = "/orderbook_md_latency";
+
+    try
+    {
+        auto publisherRing = SharedMemoryRing::Create(name, capacity);
+        MarketDataPublisher publisher{publisherRing.GetRing()};
+
+        std::atomic<bool> subscribed{false}, published{false};
+        std::vector<std::uint64_t> latencies;
+        std::uint64_t missed{}, overruns{};
+
+        std::thread subscriberThread{[&]()
+                                     {
+                                         auto subscriberRing = SharedMemoryRing::Open(name);
+                                         MarketDataSubscriber subscriber{subscriberRing.GetRing()};
+                                         latencies.reserve(count * 4);
+                                         subscribed.store(true, std::memory_order_release);
+
+                                         MarketDataEvent event;
+                                         while (true)
+                                         {
+                                             // read the flag before polling, so an empty ring after it was set really means everything was read
+                                             const bool isPublished = published.load(std::memory_order_acquire);
+                                             const auto status = subscriber.TryRead(event);
+                                             if (status == MarketDataSubscriber::ReadStatus::Ok)
+                                                 latencies.push_back(Now() - event.publishTimestamp_);
+                                             else if (status == MarketDataSubscriber::ReadStatus::Overrun)
+                                             {
+                                                 overruns++;
+                                                 subscriber.Resync();
+                                             }
+                                             else if (isPublished)
+                                                 break;
+                                         }
+                                         missed = subscriber.GetMissedCount();
+                                     }};
+
+        while (!subscribed.load(std::memory_order_acquire))
+            std::this_thread::yield();
+
+        const auto informations = GenerateInformations(count, 1);
+        OrderBook orderBook;
+        orderBook.SetMarketDataPublisher(&publisher);
+
+        const auto start = Now();
+        for (const auto &information : informations)
+        {
+            ApplyInformation(orderBook, information);
+            for (const auto until = Now() + interval; Now() < until;)
+                ;
+        }
+        const auto elapsed = Now() - start;
+
+        published.store(true, std::memory_order_release);
+        subscriberThread.join();
+
+        std::sort(latencies.begin(), latencies.end());
+        std::cout << "published: " << publisherRing.GetRing().GetWriteSequence() << " events in " << elapsed / 1'000'000 << " ms\n";
+        std::cout << "received: " << latencies.size() << ", overruns: " << overruns << ", missed: " << missed << "\n";
+        std::cout << "latency ns p50: " << Percentile(latencies, 0.5) << ", p99: " << Percentile(latencies, 0.99) << ", p99.9: " << Percentile(latencies, 0.999) << ", max: " << (latencies.empty() ? 0 : latencies.back()) << "\n";
+        return 0;
+    }
+    catch (const std::exception &e)
+    {
+        std::cerr << "Error: " << e.what() << std::endl;
+        return 1;
+    }
+}
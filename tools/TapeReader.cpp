@@ -0,0 +1,84 @@
+#include "../TradeTape.h"
+
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <string_view>
+
+// prints a trade tape written by TradeTapeWriter, one trade per line, or converts it to csv.
+// usage: TapeReader <tape> [--csv]
+int main(int argc, char **argv)
+{
+    if (argc < 2)
+    {
+        std::cerr << "usage: TapeReader <tape> [--csv]\n";
+        return 1;
+    }
+
+    const bool isCsv = argc > 2 && std::string_view{argv[2]} == "--csv";
+
+    std::ifstream tape{argv[1], std::ios::binary};
+    if (!tape)
+    {
+        std::cerr << "Could not open " << argv[1] << "\n";
+        return 1;
+    }
+
+    TradeTapeHeader header;
+    if (!tape.read(reinterpret_cast<char *>(&header), sizeof(header)) || header.magic_ != TradeTapeHeader::MagicNumber)
+    {
+        std::cerr << argv[1] << " is not a trade tape\n";
+        return 1;
+    }
+    if (header.version_ != TradeTapeHeader::CurrentVersion || header.recordSize_ != sizeof(TradeRecord))
+    {
+        std::cerr << "Unsupported trade tape version " << header.version_ << " with record size " << header.recordSize_ << "\n";
+        return 1;
+    }
+
+    std::ios::sync_with_stdio(false);
+    if (isCsv)
+        std::cout << "sequence,timestamp,bid_order_id,bid_price,bid_quantity,ask_order_id,ask_price,ask_quantity\n";
+
+    // read in large chunks, tapes can hold many millions of trades
+    std::vector<TradeRecord> records(4096);
+    std::uint64_t expectedSequence = 0;
+    std::uint64_t gaps = 0;
+    std::string output;
+
+    while (tape)
+    {
+        tape.read(reinterpret_cast<char *>(records.data()), records.size() * sizeof(TradeRecord));
+        const auto count = static_cast<std::size_t>(tape.gcount()) / sizeof(TradeRecord);
+
+        output.clear();
+        for (std::size_t i = 0; i < count; i++)
+        {
+            const auto &record = records[i];
+            if (record.sequence_ != expectedSequence)
+                gaps++;
+            expectedSequence = record.sequence_ + 1;
+
+            const auto &bid = record.bidTrade_;
+            const auto &ask = record.askTrade_;
+            if (isCsv)
+            {
+                output += std::to_string(record.sequence_) + "," + std::to_string(record.timestamp_) + "," + std::to_string(bid.orderId_) + "," + std::to_string(bid.price_) + "," + std::to_string(bid.quantity_) + "," + std::to_string(ask.orderId_) + "," + std::to_string(ask.price_) + "," + std::to_string(ask.quantity_) + "\n";
+            }
+            else
+            {
+                output += "#" + std::to_string(record.sequence_) + " @" + std::to_string(record.timestamp_) + " bid " + std::to_string(bid.orderId_) + " " + std::to_string(bid.quantity_) + "@" + std::to_string(bid.price_) + " ask " + std::to_string(ask.orderId_) + " " + std::to_string(ask.quantity_) + "@" + std::to_string(ask.price_) + "\n";
+            }
+        }
+        std::cout.write(output.data(), output.size());
+    }
+
+    // a tape cut short by a crash ends in a partial record, sequence gaps mean records went missing
+    if (tape.gcount() % sizeof(TradeRecord) != 0)
+        std::cerr << "tape ends in a partial record\n";
+    if (gaps != 0)
+        std::cerr << gaps << " sequence gaps\n";
+
+    std::cerr << expectedSequence << " trades\n";
+    return 0;
+}